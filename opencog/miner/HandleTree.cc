@@ -26,6 +26,7 @@
 #include <opencog/util/Logger.h>
 #include <opencog/util/dorepeat.h>
 
+#include <iterator>
 #include <sstream>
 
 namespace opencog {
@@ -98,6 +99,99 @@ HandleTree merge_patterns(const std::initializer_list<HandleTree>& forests)
 	return forest;
 }
 
+const unsigned FlatHandleForest::npos;
+
+HandleForest::HandleForest() {}
+
+HandleForest::HandleForest(const Handle& h) : _roots{Node{h, NodeSeq()}} {}
+
+HandleForest::HandleForest(const Handle& h, HandleForest&& children)
+{
+	push_back(h, std::move(children));
+}
+
+void HandleForest::append(HandleForest&& other)
+{
+	if (_roots.empty()) {
+		_roots = std::move(other._roots);
+	} else {
+		_roots.insert(_roots.end(),
+		              std::make_move_iterator(other._roots.begin()),
+		              std::make_move_iterator(other._roots.end()));
+	}
+	other._roots.clear();
+}
+
+void HandleForest::push_back(const Handle& h, HandleForest&& children)
+{
+	_roots.push_back(Node{h, std::move(children._roots)});
+	children._roots.clear();
+}
+
+const HandleForest::NodeSeq& HandleForest::roots() const
+{
+	return _roots;
+}
+
+bool HandleForest::empty() const
+{
+	return _roots.empty();
+}
+
+// Return the number of nodes of the given sibling nodes and their
+// descendants
+static size_t count_nodes(const HandleForest::NodeSeq& nodes)
+{
+	size_t s = nodes.size();
+	for (const HandleForest::Node& node : nodes)
+		s += count_nodes(node.children);
+	return s;
+}
+
+size_t HandleForest::size() const
+{
+	return count_nodes(_roots);
+}
+
+// Append nodes, and their descendants, as children of it
+static void append_children(HandleTree& tr, HandleTree::iterator it,
+                            const HandleForest::NodeSeq& nodes)
+{
+	for (const HandleForest::Node& node : nodes)
+		append_children(tr, tr.append_child(it, node.handle), node.children);
+}
+
+HandleTree HandleForest::to_tree() const
+{
+	HandleTree tr;
+	for (const Node& root : _roots)
+		append_children(tr, tr.insert(tr.end(), root.handle), root.children);
+	return tr;
+}
+
+// Append nodes, and their descendants, in pre-order, to flat, with
+// parent as the index of their parent.
+static void flatten_nodes(FlatHandleForest& flat, unsigned parent,
+                          const HandleForest::NodeSeq& nodes)
+{
+	for (const HandleForest::Node& node : nodes) {
+		unsigned index = flat.handles.size();
+		flat.handles.push_back(node.handle);
+		flat.parents.push_back(parent);
+		flatten_nodes(flat, index, node.children);
+	}
+}
+
+FlatHandleForest HandleForest::flatten() const
+{
+	FlatHandleForest flat;
+	size_t s = size();
+	flat.handles.reserve(s);
+	flat.parents.reserve(s);
+	flatten_nodes(flat, FlatHandleForest::npos, _roots);
+	return flat;
+}
+
 bool all_nodes_in(const HandleSet& cash, HandleTree::iterator it)
 {
 	if (cash.find(*it) == cash.end()) {
@@ -145,6 +239,11 @@ std::string oc_to_string(const HandleMapTree& hmt, const std::string& indent)
 	return ss.str();
 }
 
+std::string oc_to_string(const HandleForest& hf, const std::string& indent)
+{
+	return oc_to_string(hf.to_tree(), indent);
+}
+
 std::string oc_to_string(const HandleHandleTreeMap& hhtm, const std::string& indent)
 {
 	std::stringstream ss;
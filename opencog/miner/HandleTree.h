@@ -24,6 +24,8 @@
 #ifndef OPENCOG_HANDLETREE_H_
 #define OPENCOG_HANDLETREE_H_
 
+#include <vector>
+
 #include <opencog/util/empty_string.h>
 #include <opencog/atoms/base/Handle.h>
 #include <opencog/util/tree.h>
@@ -44,6 +46,80 @@ bool content_is_in(const Handle& h, const HandleTree& ht);
  */
 HandleTree merge_patterns(const std::initializer_list<HandleTree>&);
 
+/**
+ * Compact representation of a forest of handles, with its nodes in
+ * pre-order, each one with the index of its parent, or npos if it is
+ * a root.
+ */
+struct FlatHandleForest
+{
+	static const unsigned npos = (unsigned)-1;
+
+	HandleSeq handles;
+	std::vector<unsigned> parents;
+};
+
+/**
+ * Append-only forest of handles, meant to build the forests of
+ * patterns produced by the miner. Forests are moved rather than
+ * copied, so that appending a forest, or creating a node out of a
+ * forest of children, costs a constant time per root moved, instead
+ * of copying all nodes like merge_patterns does.
+ *
+ * Once built, it is converted into a HandleTree, or into a
+ * FlatHandleForest, more compact for large forests.
+ */
+class HandleForest
+{
+public:
+	struct Node;
+	typedef std::vector<Node> NodeSeq;
+
+	struct Node
+	{
+		Handle handle;
+		NodeSeq children;
+	};
+
+	/**
+	 * Construct an empty forest, a forest made of a single leaf h, or
+	 * a forest made of a single node h with the given children.
+	 */
+	HandleForest();
+	explicit HandleForest(const Handle& h);
+	HandleForest(const Handle& h, HandleForest&& children);
+
+	/**
+	 * Append the roots of other, and thus their descendants, to the
+	 * roots of this forest. other is left empty.
+	 */
+	void append(HandleForest&& other);
+
+	/**
+	 * Append a root h with the given children. children is left
+	 * empty.
+	 */
+	void push_back(const Handle& h, HandleForest&& children);
+
+	const NodeSeq& roots() const;
+
+	bool empty() const;
+
+	/**
+	 * Return the number of nodes.
+	 */
+	size_t size() const;
+
+	/**
+	 * Convert into a HandleTree, or into a FlatHandleForest.
+	 */
+	HandleTree to_tree() const;
+	FlatHandleForest flatten() const;
+
+private:
+	NodeSeq _roots;
+};
+
 /**
  * Check that it and all its children are in cash.
  */
@@ -53,6 +129,8 @@ std::string oc_to_string(const HandleTree& ht,
                          const std::string& indent=empty_string);
 std::string oc_to_string(const HandleMapTree& hmt,
                          const std::string& indent=empty_string);
+std::string oc_to_string(const HandleForest& hf,
+                         const std::string& indent=empty_string);
 std::string oc_to_string(const HandleHandleTreeMap& hhtm,
                          const std::string& indent=empty_string);
 
@@ -33,7 +33,10 @@
 #include <boost/range/numeric.hpp>
 #include <boost/range/algorithm/transform.hpp>
 
+#include <algorithm>
 #include <functional>
+#include <future>
+#include <string>
 
 namespace opencog
 {
@@ -42,13 +45,16 @@ namespace opencog
 // 7. make sure that filtering is still meaningfull
 
 MinerParameters::MinerParameters(unsigned ms, unsigned iconjuncts,
-                                 const Handle& ipat, int maxd)
+                                 const Handle& ipat, int maxd,
+                                 unsigned jbs, unsigned mc, unsigned mv,
+                                 bool es, unsigned k, PatternMode md)
 	: minsup(ms), initconjuncts(iconjuncts), initpat(ipat),
-	  maxdepth(maxd)
+	  maxdepth(maxd), jobs(std::max(1U, jbs)), maxconjuncts(mc),
+	  maxvariables(mv), enforce_specialization(es), topk(k), mode(md)
 {
 	// Provide initial pattern if none
 	if (not initpat) {
-		HandleSeq vars = MinerUtils::gen_rand_variables(initconjuncts);
+		HandleSeq vars = MinerUtils::gen_variables(initconjuncts);
 		Handle vardecl = MinerUtils::variable_list(vars);
 		Handle body = MinerUtils::mk_body(vars);
 		initpat = MinerUtils::lambda(vardecl, body);
@@ -71,58 +77,302 @@ MinerParameters::MinerParameters(unsigned ms, unsigned iconjuncts,
 }
 
 Miner::Miner(const MinerParameters& prm)
-	: param(prm) {}
+	: param(prm), _active_jobs(0), _sink(nullptr), _lattice(nullptr),
+	  _minsup(prm.minsup), _exact_supports(false), _main_search(false) {}
 
 HandleTree Miner::operator()(const AtomSpace& db_as)
 {
-	HandleSeq db;
-	db_as.get_handles_by_type(std::inserter(db, db.end()),
-	                          opencog::ATOM, true);
-	return operator()(db);
+	return operator()(MinerDB(db_as));
 }
 
-HandleTree Miner::operator()(const HandleSeq& db)
+HandleTree Miner::operator()(const MinerDB& db)
 {
-	return specialize(param.initpat, db, param.maxdepth);
+	return mine(db).to_tree();
+}
+
+HandleForest Miner::mine(const MinerDB& db)
+{
+	reset(db);
+	HandleForest patterns =
+		dedupe(specialize_patterns(param.initpat, db, param.maxdepth));
+	_main_search = false;
+
+	// Remove the patterns that turned out not to be amongst the topk
+	// best ones, then the ones not to be output in CLOSED or MAXIMAL
+	// mode
+	if (param.topk)
+		patterns = select_frequent(patterns.roots(), db);
+	if (param.mode != PatternMode::ALL)
+		patterns = select_mode(patterns.roots(), db);
+	return patterns;
+}
+
+void Miner::operator()(const AtomSpace& db_as, const PatternSink& sink)
+{
+	operator()(MinerDB(db_as), sink);
+}
+
+void Miner::operator()(const MinerDB& db, const PatternSink& sink)
+{
+	_emitted.clear();
+	reset(db);
+
+	// Stream patterns to sink while specializing, the returned tree
+	// is then empty.
+	_sink = &sink;
+	try {
+		specialize_patterns(param.initpat, db, param.maxdepth);
+	} catch (...) {
+		_sink = nullptr;
+		_main_search = false;
+		throw;
+	}
+	_sink = nullptr;
+	_main_search = false;
+}
+
+PatternLattice Miner::mine_lattice(const MinerDB& db)
+{
+	// Nodes hold exact supports, so they must be calculated as such
+	// from the start, including while mining conjuncts, since
+	// supports are memoized.
+	_exact_supports = true;
+	PatternLattice lattice;
+	try {
+		reset(db);
+
+		// Insert the top node with its exact support, not calculated
+		// by the search.
+		lattice.insert(param.initpat,
+		               MinerUtils::support(param.initpat, db, UINT_MAX));
+
+		// Fill the lattice while specializing, the returned tree is
+		// then empty.
+		_lattice = &lattice;
+		specialize_patterns(param.initpat, db, param.maxdepth);
+	} catch (...) {
+		_lattice = nullptr;
+		_exact_supports = false;
+		_main_search = false;
+		throw;
+	}
+	_lattice = nullptr;
+	_exact_supports = false;
+	_main_search = false;
+	return lattice;
+}
+
+unsigned Miner::minsup() const
+{
+	return _minsup;
+}
+
+void Miner::reset(const MinerDB& db)
+{
+	_support_cache.clear();
+	_explored.clear();
+	tmp_as.clear();
+	_minsup = param.minsup;
+	_topk_supports = decltype(_topk_supports)();
+	_ranked.clear();
+	_child_supports.clear();
+	_main_search = false;
+	mine_conjuncts(db);
+
+	// Patterns are only ranked by the main search, so that the
+	// minimum support used to mine conjuncts is not raised by them,
+	// and all frequent conjuncts are mined, closed or not.
+	_main_search = true;
+}
+
+void Miner::rank(const Handle& pattern, const MinerDB& db)
+{
+	unsigned support = frequent_support(pattern, db);
+
+	std::lock_guard<std::mutex> lock(_topk_mtx);
+	if (not _ranked.insert(MinerUtils::canonical_key(pattern)).second)
+		return;
+	if (_topk_supports.size() < param.topk)
+		_topk_supports.push(support);
+	else if (_topk_supports.top() < support) {
+		_topk_supports.pop();
+		_topk_supports.push(support);
+	}
+	if (_topk_supports.size() == param.topk and _minsup < _topk_supports.top())
+		_minsup = _topk_supports.top();
+}
+
+HandleForest Miner::select_frequent(const HandleForest::NodeSeq& patterns,
+                                    const MinerDB& db) const
+{
+	HandleForest selected;
+	for (const HandleForest::Node& node : patterns)
+		if (minsup() <= frequent_support(node.handle, db))
+			selected.push_back(node.handle,
+			                   select_frequent(node.children, db));
+	return selected;
+}
+
+bool Miner::selected(const Handle& pattern, const MinerDB& db) const
+{
+	if (param.mode == PatternMode::ALL)
+		return true;
+	auto it = _child_supports.find(MinerUtils::canonical_key(pattern));
+	if (it == _child_supports.end())
+		return true;
+	unsigned ms = param.mode == PatternMode::CLOSED ?
+		frequent_support(pattern, db) : minsup();
+	return it->second < ms;
+}
+
+void Miner::specialized(const Handle& parent, const Handle& pattern,
+                        const MinerDB& db)
+{
+	unsigned support = frequent_support(pattern, db);
+
+	std::lock_guard<std::mutex> lock(_specialized_mtx);
+	unsigned& child_support = _child_supports[MinerUtils::canonical_key(parent)];
+	child_support = std::max(child_support, support);
+}
+
+HandleForest Miner::select_mode(const HandleForest::NodeSeq& patterns,
+                                const MinerDB& db) const
+{
+	HandleForest selected_patterns;
+	for (const HandleForest::Node& node : patterns) {
+		HandleForest children = select_mode(node.children, db);
+		if (selected(node.handle, db))
+			selected_patterns.push_back(node.handle, std::move(children));
+		else
+			selected_patterns.append(std::move(children));
+	}
+	return selected_patterns;
+}
+
+bool Miner::equivalent_shapat(const Handle& pattern,
+                              const Valuations& valuations,
+                              Handle& var, Handle& shapat) const
+{
+	if (param.mode == PatternMode::ALL or not _main_search or
+	    pattern->get_type() != LAMBDA_LINK or valuations.size() == 0)
+		return false;
+
+	// The specializations of pattern composed with shapat are one
+	// level deeper, and may have more variables, or require more
+	// specializations to be reached, thus pruning is only sound if
+	// neither depth nor variables are bounded.
+	if (0 <= param.maxdepth or param.maxvariables != UINT_MAX)
+		return false;
+
+	// Shallow abstractions covering all valuations, per variable
+	HandleSetSeq shabs = MinerUtils::shallow_abstract(valuations,
+	                                                  valuations.size());
+	const Variables& vars = MinerUtils::get_variables(pattern);
+	for (unsigned i = 0; i < shabs.size(); i++) {
+		for (const Handle& sa : shabs[i]) {
+			// Only consider link abstractions, as constants and
+			// variable factorizations are not always produced (see
+			// MinerUtils::focus_shallow_abstract), thus specializations
+			// of pattern could not be reached from their compositions.
+			if (sa->get_type() != LAMBDA_LINK)
+				continue;
+
+			// Provided that specialization can be mined, see admissible
+			Handle asa = MinerUtils::alpha_convert(sa, vars);
+			if (admissible(MinerUtils::compose(pattern, {{vars.varseq[i], asa}}))) {
+				var = vars.varseq[i];
+				shapat = sa;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+unsigned Miner::support_ms() const
+{
+	return param.topk or param.mode == PatternMode::CLOSED or _exact_supports ?
+		UINT_MAX : minsup();
+}
+
+void Miner::mine_conjuncts(const MinerDB& db)
+{
+	_conjuncts.clear();
+	if (param.maxconjuncts <= param.initconjuncts)
+		return;
+
+	// Mine all frequent patterns up to maxdepth from the single
+	// conjunct top pattern. As _conjuncts is empty, no conjunction
+	// expansion takes place.
+	HandleSeq vars = MinerUtils::gen_variables(1);
+	Handle top = MinerUtils::lambda(MinerUtils::variable_list(vars),
+	                                MinerUtils::mk_body(vars));
+	FlatHandleForest patterns =
+		specialize_patterns(top, db, param.maxdepth).flatten();
+
+	// Collect them, the order of the forest does not depend on the
+	// scheduling, thus neither does the one of _conjuncts.
+	HandleSet seen;
+	for (const Handle& pattern : patterns.handles)
+		if (MinerUtils::n_conjuncts(pattern) == 1 and
+		    not MinerUtils::totally_abstract(pattern) and
+		    seen.insert(pattern).second)
+			_conjuncts.push_back(pattern);
+
+	// The specializations of these patterns must be explored again,
+	// this time expanding their conjunctions.
+	_explored.clear();
 }
 
 HandleTree Miner::specialize(const Handle& pattern,
-                             const HandleSeq& db,
+                             const MinerDB& db,
                              int maxdepth)
 {
-	// TODO: decide what to choose and remove or comment
-	// return specialize_alt(pattern, db, Valuations(pattern, db), maxdepth);
-	return specialize(pattern, db, Valuations(pattern, db), maxdepth);
+	return specialize_patterns(pattern, db, maxdepth).to_tree();
 }
 
 HandleTree Miner::specialize(const Handle& pattern,
-                             const HandleSeq& db,
+                             const MinerDB& db,
                              const Valuations& valuations,
                              int maxdepth)
+{
+	return specialize_patterns(pattern, db, valuations, maxdepth).to_tree();
+}
+
+HandleForest Miner::specialize_patterns(const Handle& pattern,
+                                        const MinerDB& db,
+                                        int maxdepth)
+{
+	// TODO: decide what to choose and remove or comment
+	// return specialize_alt(pattern, db, Valuations(pattern, db), maxdepth);
+	return specialize_patterns(pattern, db, Valuations(pattern, db), maxdepth);
+}
+
+HandleForest Miner::specialize_patterns(const Handle& pattern,
+                                        const MinerDB& db,
+                                        const Valuations& valuations,
+                                        int maxdepth)
 {
 	// One of the termination criteria has been reached
 	if (terminate(pattern, db, valuations, maxdepth))
-		return HandleTree();
+		return HandleForest();
 
 	// Produce specializations from other variables than the front
 	// one.
 	valuations.inc_focus_variable();
-	HandleTree patterns = specialize(pattern, db, valuations, maxdepth);
+	HandleForest patterns = specialize_patterns(pattern, db, valuations,
+	                                            maxdepth);
 	valuations.dec_focus_variable();
 
 	// Produce specializations from shallow abstractions on the front
-	// variable, and so recusively.
-	HandleTree shabs_pats = specialize_shabs(pattern, db, valuations,
-	                                         maxdepth);
-
-	// Merge specializations to patterns while discarding duplicates
-	patterns = merge_patterns({patterns, shabs_pats});
+	// variable, and so recusively, and append them to patterns.
+	patterns.append(specialize_shabs(pattern, db, valuations, maxdepth));
 
 	return patterns;
 }
 
 HandleTree Miner::specialize_alt(const Handle& pattern,
-                                 const HandleSeq& db,
+                                 const MinerDB& db,
                                  const Valuations& valuations,
                                  int maxdepth)
 {
@@ -130,30 +380,27 @@ HandleTree Miner::specialize_alt(const Handle& pattern,
 	if (terminate(pattern, db, valuations, maxdepth))
 		return HandleTree();
 
-	HandleTree patterns;
+	HandleForest patterns;
 	Variables vars = MinerUtils::get_variables(pattern);
 
 	// Calculate all shallow abstractions of pattern
-	HandleSetSeq shabs = MinerUtils::shallow_abstract(valuations, param.minsup);
+	HandleSetSeq shabs = MinerUtils::shallow_abstract(valuations, minsup());
 
 	// Generate all associated specializations
 	for (unsigned i = 0; i < shabs.size(); i++) {
 		for (const Handle& shapat : shabs[i]) {
 			// Compose pattern with shapat to obtain a specialization,
-			// and recursively specialize the result
-			HandleTree npats = specialize_shapat(pattern, db,
-			                                     vars.varseq[i], shapat,
-			                                     maxdepth);
-
-			// Insert specializations
-			patterns = merge_patterns({patterns, npats});
+			// recursively specialize the result, and insert them
+			patterns.append(specialize_shapat(pattern, db, valuations,
+			                                  vars.varseq[i], shapat,
+			                                  maxdepth));
 		}
 	}
-	return patterns;
+	return patterns.to_tree();
 }
 
 bool Miner::terminate(const Handle& pattern,
-                      const HandleSeq& db,
+                      const MinerDB& db,
                       const Valuations& valuations,
                       int maxdepth) const
 {
@@ -165,64 +412,389 @@ bool Miner::terminate(const Handle& pattern,
 		// There is no more variable to specialize from
 		valuations.no_focus() or
 		// The pattern doesn't have enough support
-		not MinerUtils::enough_support(pattern, db, param.minsup);
+		not enough_support(pattern, db);
 }
 
-HandleTree Miner::specialize_shabs(const Handle& pattern,
-                                   const HandleSeq& db,
-                                   const Valuations& valuations,
-                                   int maxdepth)
+HandleForest Miner::specialize_shabs(const Handle& pattern,
+                                     const MinerDB& db,
+                                     const Valuations& valuations,
+                                     int maxdepth)
 {
 	// Generate shallow patterns of the first variable of the
 	// valuations and associate the remaining valuations (excluding
 	// that variable) to them.
-	HandleSet shapats = MinerUtils::focus_shallow_abstract(valuations, param.minsup);
+	HandleSet shapats = MinerUtils::focus_shallow_abstract(valuations, minsup());
 
 	// No shallow abstraction to use for specialization
 	if (shapats.empty())
-		return HandleTree();
+		return HandleForest();
 
 	// For each shallow abstraction, create a specialization from
 	// pattern by composing it, and recursively specialize the result
-	// with the new resulting valuations.
-	HandleTree patterns;
+	// with the new resulting valuations. Each of them is launched in
+	// its own thread if a job is available, otherwise it is deferred
+	// to the current thread.
 	Handle var = valuations.focus_variable();
+	std::vector<bool> asyncs;
+	std::vector<std::future<HandleForest>> npats_futures;
 	for (const auto& shapat : shapats)
 	{
-		// Specialize pattern by composing it with shapat, and
-		// specialize the result recursively
-		HandleTree npats
-			= specialize_shapat(pattern, db, var, shapat, maxdepth);
+		bool async = acquire_job();
+		asyncs.push_back(async);
+		npats_futures.push_back(std::async(
+			async ? std::launch::async : std::launch::deferred,
+			[&, async]() {
+				// Specialize pattern by composing it with shapat, and
+				// specialize the result recursively
+				HandleForest npats;
+				try {
+					npats = specialize_shapat(pattern, db, valuations, var,
+					                          shapat, maxdepth);
+				} catch (...) {
+					if (async)
+						release_job();
+					throw;
+				}
+				if (async)
+					release_job();
+				return npats;
+			}));
+	}
 
-		// Insert specializations
-		patterns = merge_patterns({patterns, npats});
+	// Run the deferred specializations first, while the launched ones
+	// are being processed in parallel
+	std::vector<HandleForest> npats_seq(npats_futures.size());
+	for (size_t i = 0; i < npats_futures.size(); i++)
+		if (not asyncs[i])
+			npats_seq[i] = npats_futures[i].get();
+	for (size_t i = 0; i < npats_futures.size(); i++)
+		if (asyncs[i])
+			npats_seq[i] = npats_futures[i].get();
+
+	// Insert specializations, in the order of shapats so that the
+	// result does not depend on the scheduling
+	HandleForest patterns;
+	for (HandleForest& npats : npats_seq)
+		patterns.append(std::move(npats));
+	return patterns;
+}
+
+bool Miner::acquire_job()
+{
+	// The calling thread counts as one job
+	unsigned active = _active_jobs.load();
+	while (active + 1 < param.jobs)
+		if (_active_jobs.compare_exchange_weak(active, active + 1))
+			return true;
+	return false;
+}
+
+void Miner::release_job()
+{
+	_active_jobs--;
+}
+
+std::string Miner::explored_key(const Handle& pattern, int maxdepth) const
+{
+	std::string key = MinerUtils::canonical_key(pattern);
+	if (0 <= maxdepth)
+		key += " @" + std::to_string(maxdepth);
+	return key;
+}
+
+unsigned Miner::frequent_support(const Handle& pattern,
+                                 const MinerDB& db) const
+{
+	double sup = MinerUtils::get_support(pattern);
+	if (0 <= sup)
+		return sup;
+	unsigned support = minsup();
+	_support_cache.support(MinerUtils::canonical_key(pattern), db,
+	                       support_ms(), support);
+	return support;
+}
+
+void Miner::emit(const Handle& pattern, const Handle& parent,
+                 const MinerDB& db, bool claimed)
+{
+	// Unless the depth is bounded, a pattern is claimed once, when
+	// first reached, so there is no need to remember emitted ones.
+	bool bounded = 0 <= param.maxdepth;
+	if (not bounded and not claimed)
+		return;
+	std::string key = bounded ? MinerUtils::canonical_key(pattern) : "";
+	unsigned support = frequent_support(pattern, db);
+
+	std::lock_guard<std::mutex> lock(_sink_mtx);
+	if (not bounded or _emitted.insert(key).second)
+		(*_sink)(pattern, support, parent);
+}
+
+void Miner::insert_lattice(const Handle& pattern, const Handle& parent,
+                           const MinerDB& db)
+{
+	unsigned support = frequent_support(pattern, db);
+
+	std::lock_guard<std::mutex> lock(_lattice_mtx);
+	PatternLattice::NodeId pid = _lattice->find(parent);
+	if (pid == PatternLattice::npos)
+		pid = _lattice->insert(parent, frequent_support(parent, db));
+	_lattice->connect(pid, _lattice->insert(pattern, support));
+}
+
+bool Miner::streaming() const
+{
+	return _sink or _lattice;
+}
+
+bool Miner::claim(const Handle& pattern, int maxdepth)
+{
+	std::string key = explored_key(pattern, maxdepth);
+	std::lock_guard<std::mutex> lock(_explored_mtx);
+	return _explored.insert(key).second;
+}
+
+HandleForest Miner::dedupe(const HandleForest& patterns) const
+{
+	// Depth of exploration of a pattern at the given depth in patterns
+	auto maxdepth = [&](int depth) {
+		return param.maxdepth < 0 ? -1 : param.maxdepth - 1 - depth;
+	};
+
+	// Find the explored occurrence of each pattern, that is the one
+	// with children, if any. Patterns are visited in pre-order.
+	KeyNodeMap explored;
+	std::vector<std::pair<const HandleForest::Node*, int>> to_visit;
+	for (auto it = patterns.roots().rbegin(); it != patterns.roots().rend(); ++it)
+		to_visit.push_back({&*it, 0});
+	while (not to_visit.empty()) {
+		const HandleForest::Node* node = to_visit.back().first;
+		int depth = to_visit.back().second;
+		to_visit.pop_back();
+		std::string key = explored_key(node->handle, maxdepth(depth));
+		auto eit = explored.find(key);
+		if (eit == explored.end())
+			explored.insert({key, node});
+		else if (eit->second->children.size() < node->children.size())
+			eit->second = node;
+		for (auto it = node->children.rbegin(); it != node->children.rend(); ++it)
+			to_visit.push_back({&*it, depth + 1});
+	}
+
+	std::vector<const HandleForest::Node*> roots;
+	for (const HandleForest::Node& root : patterns.roots())
+		roots.push_back(&root);
+	CanonicalKeySet seen;
+	return dedupe(roots, 0, explored, seen);
+}
+
+HandleForest Miner::dedupe(const std::vector<const HandleForest::Node*>& siblings,
+                           int depth,
+                           const KeyNodeMap& explored,
+                           CanonicalKeySet& seen) const
+{
+	HandleForest patterns;
+	for (const HandleForest::Node* node : siblings) {
+		int md = param.maxdepth < 0 ? -1 : param.maxdepth - 1 - depth;
+		std::string key = explored_key(node->handle, md);
+		if (not seen.insert(key).second)
+			continue;
+
+		// Recursively dedupe the children of the explored occurrence
+		const HandleForest::Node* enode = explored.at(key);
+		std::vector<const HandleForest::Node*> children;
+		for (const HandleForest::Node& child : enode->children)
+			children.push_back(&child);
+		patterns.push_back(node->handle,
+		                   dedupe(children, depth + 1, explored, seen));
 	}
 	return patterns;
 }
 
-HandleTree Miner::specialize_shapat(const Handle& pattern,
-                                    const HandleSeq& db,
-                                    const Handle& var,
-                                    const Handle& shapat,
-                                    int maxdepth)
+Miner::LazyOccurrences::LazyOccurrences(const Valuations* vals)
+	: valuations(vals), built(false), known(false) {}
+
+const OccurrenceSet* Miner::LazyOccurrences::get()
+{
+	if (valuations and not built) {
+		known = valuations->occurrences(occs);
+		built = true;
+	}
+	return known ? &occs : nullptr;
+}
+
+bool Miner::enough_support(const Handle& pattern,
+                           const MinerDB& db,
+                           LazyOccurrences* occs) const
+{
+	// The minimum support may rise while checking it, in top-k mode,
+	// in which case checking against the former one remains sound.
+	unsigned ms = minsup();
+	std::string key = MinerUtils::canonical_key(pattern);
+	bool enough;
+	if (_support_cache.lookup(key, db, ms, enough))
+		return enough;
+
+	// Unless its support is already memoized, reject pattern if one
+	// of its generalizations is known to be infrequent.
+	double sup = MinerUtils::get_support(pattern);
+	if (sup < 0) {
+		for (const Handle& gen : MinerUtils::generalizations(pattern)) {
+			if (_support_cache.infrequent(MinerUtils::canonical_key(gen),
+			                              db, ms)) {
+				_support_cache.insert_infrequent(key, db, ms);
+				return false;
+			}
+		}
+		sup = MinerUtils::support_mem(pattern, db, support_ms(),
+		                              occs ? occs->get() : nullptr,
+		                              &_support_cache);
+	}
+
+	_support_cache.insert(key, db, (unsigned)sup, support_ms());
+	return ms <= sup;
+}
+
+HandleForest Miner::specialize_shapat(const Handle& pattern,
+                                      const MinerDB& db,
+                                      const Valuations& valuations,
+                                      const Handle& var,
+                                      const Handle& shapat,
+                                      int maxdepth)
 {
+	// Rename the variables of shapat colliding with the ones of
+	// pattern, so that the variables of npat can be traced back to
+	// either of them when deriving its valuations.
+	Handle ashapat = MinerUtils::alpha_convert(shapat,
+	                                           MinerUtils::get_variables(pattern));
+
 	// Perform the composition (that is specialize)
-	Handle npat = MinerUtils::compose(pattern, {{var, shapat}});
+	Handle npat = MinerUtils::compose(pattern, {{var, ashapat}});
 
-	// If the specialization has too few conjuncts, dismiss it.
-	if (MinerUtils::n_conjuncts(npat) < param.initconjuncts)
-		return HandleTree();
+	// If the specialization has too few conjuncts or too many
+	// variables, dismiss it.
+	if (not admissible(npat))
+		return HandleForest();
+
+	// Derive the valuations of npat from the valuations of pattern if
+	// possible.
+	Valuations nvals(MinerUtils::get_variables(npat));
+	bool derived = valuations.specialize(var, ashapat, npat, nvals);
+
+	if (derived)
+		return specialize_spe(npat, pattern, db, &nvals, maxdepth);
+
+	// Otherwise its support and valuations are calculated by
+	// matching only the data trees where pattern occurs, if known.
+	return specialize_spe(npat, pattern, db, nullptr, maxdepth, &valuations);
+}
+
+bool Miner::admissible(const Handle& npat) const
+{
+	return param.initconjuncts <= MinerUtils::n_conjuncts(npat) and
+		MinerUtils::get_variables(npat).varseq.size() <= param.maxvariables;
+}
+
+HandleForest Miner::specialize_spe(const Handle& spe,
+                                   const Handle& parent,
+                                   const MinerDB& db,
+                                   Valuations* svals,
+                                   int maxdepth,
+                                   const Valuations* pvals)
+{
+	// Put its clauses in canonical order and name its variables
+	// accordingly, so that its specializations do not depend on the
+	// branch it is reached from. Adding it to tmp_as then turns equal
+	// patterns into the same atom, sharing their memoized supports.
+	HandleMap renaming;
+	Handle npat = tmp_as.add_atom(MinerUtils::canonical_pattern(spe, &renaming));
+	if (svals)
+		svals->rename(MinerUtils::get_variables(npat), renaming);
+
+	// Since the support of npat is the size of its derived valuations,
+	// memoize it to avoid calling the pattern matcher.
+	if (svals and not svals->scvs.empty() and
+	    MinerUtils::get_support(npat) < 0)
+		MinerUtils::set_support(npat, svals->size());
 
 	// That specialization doesn't have enough support, skip it
 	// and its specializations.
-	if (not MinerUtils::enough_support(npat, db, param.minsup))
-		return HandleTree();
+	LazyOccurrences occs(svals ? nullptr : pvals);
+	if (not enough_support(npat, db, &occs))
+		return HandleForest();
+
+	// It is frequent, rank it in top-k mode, record it as a
+	// specialization of parent in CLOSED or MAXIMAL mode, and stream
+	// it if requested
+	if (param.topk and _main_search)
+		rank(npat, db);
+	if (param.mode != PatternMode::ALL and _main_search)
+		specialized(parent, npat, db);
+	bool claimed = claim(npat, maxdepth - 1);
+	if (_sink)
+		emit(npat, parent, db, claimed);
+	if (_lattice)
+		insert_lattice(npat, parent, db);
+
+	// That specialization, up to variable renaming and clause
+	// ordering, has already been reached from another branch, no
+	// need to specialize it again (see Miner::dedupe).
+	if (not claimed)
+		return streaming() ? HandleForest() : HandleForest(npat);
+
+	// Specialize npat (with new valuations, only matched against the
+	// data trees where parent occurs, if known)
+	HandleForest npats = svals ?
+		specialize_frequent(npat, db, *svals, maxdepth - 1)
+		: specialize_frequent(npat, db, Valuations(npat, db, occs.get()),
+		                      maxdepth - 1);
+
+	// Return npat and its children, unless streamed
+	if (streaming())
+		return HandleForest();
+	return HandleForest(npat, std::move(npats));
+}
 
-	// Specialize npat from all variables (with new valuations)
-	HandleTree nvapats = specialize(npat, db, maxdepth - 1);
+HandleForest Miner::specialize_frequent(const Handle& pattern,
+                                        const MinerDB& db,
+                                        const Valuations& valuations,
+                                        int maxdepth)
+{
+	// If a shallow specialization has the same support, the other
+	// ones cannot be closed, nor maximal, only explore that one.
+	// Otherwise specialize pattern from all variables.
+	Handle var, shapat;
+	HandleForest patterns =
+		maxdepth != 0 and equivalent_shapat(pattern, valuations, var, shapat) ?
+		specialize_shapat(pattern, db, valuations, var, shapat, maxdepth)
+		: specialize_patterns(pattern, db, valuations, maxdepth);
+
+	// Conjunction expansions are always explored, as the ones of the
+	// equivalent specialization cannot share the variable it replaces.
+	patterns.append(specialize_cnjexp(pattern, db, maxdepth));
+	return patterns;
+}
 
-	// Return npat and its children
-	return HandleTree(npat, {nvapats});
+HandleForest Miner::specialize_cnjexp(const Handle& pattern,
+                                      const MinerDB& db,
+                                      int maxdepth)
+{
+	if (maxdepth == 0 or _conjuncts.empty() or
+	    param.maxconjuncts <= MinerUtils::n_conjuncts(pattern) or
+	    MinerUtils::totally_abstract(pattern))
+		return HandleForest();
+
+	HandleForest patterns;
+	for (const Handle& conjunct : _conjuncts) {
+		HandleSet npats =
+			MinerUtils::expand_conjunction(pattern, conjunct, db,
+			                               minsup(), param.maxvariables,
+			                               param.enforce_specialization);
+		for (const Handle& npat : npats)
+			patterns.append(specialize_spe(npat, pattern, db,
+			                               nullptr, maxdepth));
+	}
+	return patterns;
 }
 
 } // namespace opencog
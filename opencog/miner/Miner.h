@@ -28,7 +28,17 @@
 #include <opencog/atoms/core/RewriteLink.h>
 #include <opencog/atomspace/AtomSpace.h>
 
+#include <atomic>
+#include <climits>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+
 #include "HandleTree.h"
+#include "MinerDB.h"
+#include "PatternLattice.h"
+#include "SupportCache.h"
 #include "Valuations.h"
 #include "MinerUtils.h"
 
@@ -37,6 +47,14 @@ class MinerUTest;
 namespace opencog
 {
 
+/**
+ * Frequent patterns output by Miner. ALL outputs every frequent
+ * pattern, CLOSED only the closed ones, that have no specialization
+ * with the same support, and MAXIMAL only the maximal ones, that have
+ * no frequent specialization.
+ */
+enum class PatternMode { ALL, CLOSED, MAXIMAL };
+
 /**
  * Parameters for Miner. The terminology is taken from
  * Frequent Subtree Mining -- An Overview, from Yun Chi et al, when
@@ -51,7 +69,13 @@ struct MinerParameters {
 	MinerParameters(unsigned minsup=1,
 	                unsigned conjuncts=1,
 	                const Handle& initpat=Handle::UNDEFINED,
-	                int maxdepth=-1);
+	                int maxdepth=-1,
+	                unsigned jobs=1,
+	                unsigned maxconjuncts=1,
+	                unsigned maxvariables=UINT_MAX,
+	                bool enforce_specialization=true,
+	                unsigned topk=0,
+	                PatternMode mode=PatternMode::ALL);
 
 	// TODO: change frequency by support!!!
 	// Minimum support. Mined patterns must have a frequency equal or
@@ -75,10 +99,59 @@ struct MinerParameters {
 
 	// Maximum depth from pattern to output. If negative, then no
 	// depth limit. Depth is the number of specializations between the
-	// initial pattern and the produced patterns.
+	// initial pattern and the produced patterns. It also bounds the
+	// depth of the single conjunct patterns conjunctions are expanded
+	// with (see maxconjuncts), from the single conjunct top pattern,
+	// as a conjunction is at least as deep as its conjuncts.
 	int maxdepth;
+
+	// Maximum number of threads used to explore the specialization
+	// tree. If 1, then the search is entirely sequential. The result
+	// does not depend on it.
+	unsigned jobs;
+
+	// Maximum number of conjuncts of the mined patterns. If above the
+	// number of conjuncts of initpat, then patterns are not only
+	// specialized by shallow abstractions, but also by incrementally
+	// expanding their conjunctions with frequent single conjunct
+	// patterns (see MinerUtils::expand_conjunction), like the
+	// conjunction expansion rule of the URE based miner does.
+	unsigned maxconjuncts;
+
+	// Maximum number of variables of the mined patterns.
+	unsigned maxvariables;
+
+	// Flag whether conjunction expansion is restricted to
+	// specializations, that is to expansions introducing no new
+	// variable.
+	bool enforce_specialization;
+
+	// If positive, only the topk patterns of highest supports are
+	// mined, in which case minsup is raised during mining to the
+	// support of the topk-th best pattern found so far, so that
+	// patterns that cannot be amongst the topk best are pruned. Ties
+	// with the topk-th best pattern are kept as well. If null, all
+	// patterns reaching minsup are mined.
+	unsigned topk;
+
+	// Frequent patterns to output, see PatternMode. Specializations
+	// are only considered up to maxdepth, maxconjuncts and
+	// maxvariables. In CLOSED or MAXIMAL mode, if neither maxdepth
+	// nor maxvariables is set, and a pattern has a link shallow
+	// specialization with the same support, none of its other shallow
+	// specializations can be closed, thus only that one is explored.
+	PatternMode mode;
 };
 
+/**
+ * Callback receiving a mined pattern, its support and its parent,
+ * that is the pattern it is a specialization of (see
+ * Miner::operator()).
+ */
+typedef std::function<void(const Handle& pattern,
+                           unsigned support,
+                           const Handle& parent)> PatternSink;
+
 /**
  * Experimental pattern miner. Mined patterns should be compatible
  * with the pattern matcher, that is if feed to the pattern matcher,
@@ -106,14 +179,84 @@ public:
 	/**
 	 * Like above but only mine amongst the provided data tree collection.
 	 */
-	HandleTree operator()(const HandleSeq& db);
+	HandleTree operator()(const MinerDB& db);
+
+	/**
+	 * Like above but return the forest of patterns as built, to be
+	 * converted into a HandleTree, or into a FlatHandleForest, more
+	 * compact for large outputs.
+	 */
+	HandleForest mine(const MinerDB& db);
+
+	/**
+	 * Like above but rather than returning a tree of patterns, pass
+	 * each pattern to sink as soon as it is proven frequent, along
+	 * with its support and its parent, param.initpat for the top
+	 * patterns. Thus no tree is built and patterns can be consumed,
+	 * for instance written to disk, while mining.
+	 *
+	 * Each pattern is passed once, with the parent it is first reached
+	 * from. Its support is exact if known, otherwise it is calculated
+	 * up to minsup (see MinerUtils::support). Calls to sink are
+	 * serialized, so it does not need to be thread safe even if
+	 * param.jobs is above 1.
+	 *
+	 * Note that, although no tree is built, memory is not bounded by
+	 * the search frontier. Until the end of the run, the miner keeps,
+	 * for every pattern evaluated so far, frequent or not, its
+	 * canonical form in tmp_as, its support in _support_cache and,
+	 * if explored, its key in _explored, so that no pattern is
+	 * evaluated or explored twice. Thus memory grows with the number
+	 * of candidate patterns, which is at least the number of output
+	 * ones. Only the set of emitted patterns is spared, when
+	 * param.maxdepth is negative (see emit).
+	 */
+	void operator()(const AtomSpace& db_as, const PatternSink& sink);
+	void operator()(const MinerDB& db, const PatternSink& sink);
+
+	/**
+	 * Like above but return the lattice of patterns, filled while
+	 * mining, with param.initpat as top node. Each pattern has a
+	 * single node, linked to all the explored patterns it is a
+	 * specialization of, rather than being repeated for each of
+	 * them. Each node holds the exact support of its pattern, even if
+	 * above the minimum support, thus calculating it may take longer
+	 * than merely checking that it is frequent.
+	 */
+	PatternLattice mine_lattice(const MinerDB& db);
+
+	/**
+	 * Return the minimum support in use, that is param.minsup, or, in
+	 * top-k mode (see MinerParameters::topk), the support of the
+	 * topk-th best pattern found so far if higher.
+	 *
+	 * Once mining is over, patterns below it have been removed from
+	 * the tree or forest returned by operator() and mine, but not
+	 * from the patterns passed to a sink, or inserted in a lattice,
+	 * which must be filtered by their supports.
+	 */
+	unsigned minsup() const;
+
+	/**
+	 * Return true iff pattern, mined by the last search, is to be
+	 * output according to param.mode, that is always in ALL mode,
+	 * and iff no specialization of it found during the search has the
+	 * same support in CLOSED mode, or reaches minsup() in MAXIMAL
+	 * mode.
+	 *
+	 * Patterns not to be output have been removed from the tree or
+	 * forest returned by operator() and mine, but not from the
+	 * patterns passed to a sink, or inserted in a lattice, which must
+	 * be filtered with it once mining is over.
+	 */
+	bool selected(const Handle& pattern, const MinerDB& db) const;
 
 	/**
 	 * Specialization. Given a pattern and a collection of data trees,
 	 * generate all specialized patterns of the given pattern.
 	 */
 	HandleTree specialize(const Handle& pattern,
-	                      const HandleSeq& db,
+	                      const MinerDB& db,
 	                      int maxdepth=-1);
 
 	/**
@@ -121,7 +264,7 @@ public:
 	 * valuations.
 	 */
 	HandleTree specialize(const Handle& pattern,
-	                      const HandleSeq& db,
+	                      const MinerDB& db,
 	                      const Valuations& valuations,
 	                      int maxdepth);
 
@@ -129,7 +272,7 @@ public:
 	 * Alternate specialization that reflects how the URE would work.
 	 */
 	HandleTree specialize_alt(const Handle& pattern,
-	                          const HandleSeq& db,
+	                          const MinerDB& db,
 	                          const Valuations& valuations,
 	                          int maxdepth);
 
@@ -138,15 +281,230 @@ public:
 
 private:
 
+	// Patterns produced so far, in canonical form (see
+	// MinerUtils::canonical_pattern), so that equal patterns are the
+	// same atom and share their memoized values.
 	mutable AtomSpace tmp_as;
 
+	// Supports of the patterns evaluated so far, w.r.t. minsup
+	mutable SupportCache _support_cache;
+
+	// Frequent single conjunct patterns to expand conjunctions with
+	// (see mine_conjuncts).
+	HandleSeq _conjuncts;
+
+	// Keys (see explored_key) of the patterns specialized so far
+	std::mutex _explored_mtx;
+	CanonicalKeySet _explored;
+
+	// Number of threads, besides the calling one, currently exploring
+	// the specialization tree.
+	std::atomic<unsigned> _active_jobs;
+
+	// Sink mined patterns are passed to, if any, instead of being
+	// returned (see operator()).
+	const PatternSink* _sink;
+
+	// Canonical keys of the patterns passed to _sink so far, only
+	// used if the depth is bounded (see emit).
+	std::mutex _sink_mtx;
+	CanonicalKeySet _emitted;
+
+	// Lattice mined patterns are inserted in, if any, instead of being
+	// returned (see mine_lattice).
+	PatternLattice* _lattice;
+	std::mutex _lattice_mtx;
+
+	// Minimum support in use, see minsup()
+	std::atomic<unsigned> _minsup;
+
+	// In top-k mode, supports of the best patterns found so far,
+	// smallest first, and their canonical keys. Only filled by the
+	// main search (see _main_search), not by mine_conjuncts.
+	std::mutex _topk_mtx;
+	std::priority_queue<unsigned, std::vector<unsigned>,
+	                    std::greater<unsigned>> _topk_supports;
+	CanonicalKeySet _ranked;
+
+	// True while mining a lattice, so that supports are calculated
+	// exactly (see support_ms).
+	bool _exact_supports;
+
+	// True while the main search runs, as opposed to mine_conjuncts
+	bool _main_search;
+
+	// In CLOSED or MAXIMAL mode, highest support of the frequent
+	// specializations found so far of each pattern, by canonical key
+	// (see specialized).
+	std::mutex _specialized_mtx;
+	std::unordered_map<std::string, unsigned, CanonicalKeyHash> _child_supports;
+
+	/**
+	 * Occurrences of a pattern (see Valuations::occurrences), built
+	 * from its valuations upon first use only, as they are often not
+	 * needed, such as when the support of its specialization is
+	 * cached.
+	 */
+	struct LazyOccurrences
+	{
+		LazyOccurrences(const Valuations* vals=nullptr);
+
+		/**
+		 * Return the occurrences, or nullptr if unknown.
+		 */
+		const OccurrenceSet* get();
+
+		const Valuations* valuations;
+		bool built;
+		bool known;
+		OccurrenceSet occs;
+	};
+
+	/**
+	 * Reset the search state, supports, explored patterns and minimum
+	 * support, before mining db.
+	 */
+	void reset(const MinerDB& db);
+
+	/**
+	 * In top-k mode, rank the frequent pattern amongst the best
+	 * patterns found so far, unless already ranked, and raise
+	 * _minsup to the support of the topk-th best one if there are
+	 * topk of them.
+	 */
+	void rank(const Handle& pattern, const MinerDB& db);
+
+	/**
+	 * Return the given patterns, and their descendants, reaching
+	 * minsup(). Since specializations have lower supports than their
+	 * generalizations, patterns below it are removed with their
+	 * descendants.
+	 */
+	HandleForest select_frequent(const HandleForest::NodeSeq& patterns,
+	                             const MinerDB& db) const;
+
+	/**
+	 * In CLOSED or MAXIMAL mode, record that pattern, frequent, is a
+	 * specialization of parent, see selected.
+	 */
+	void specialized(const Handle& parent, const Handle& pattern,
+	                 const MinerDB& db);
+
+	/**
+	 * Return the given patterns, and their descendants, where the
+	 * ones not to be output (see selected) are replaced by their
+	 * children, recursively.
+	 */
+	HandleForest select_mode(const HandleForest::NodeSeq& patterns,
+	                         const MinerDB& db) const;
+
+	/**
+	 * In CLOSED or MAXIMAL mode, during the main search, look for a
+	 * link shallow abstraction of a variable of pattern covering all
+	 * its valuations, that is such that the specialization obtained
+	 * by composing it has the same support. If found, set var and
+	 * shapat to them and return true.
+	 *
+	 * Since specializations of pattern have a subset of its
+	 * groundings, composing them with shapat does not change their
+	 * supports either, thus they are not closed, unless they are
+	 * specializations of that composition as well. Exploring the
+	 * latter is then enough.
+	 *
+	 * That only holds if the search is bounded by neither
+	 * param.maxdepth nor param.maxvariables, as these compositions
+	 * are deeper and may have more variables, in which case false is
+	 * returned.
+	 */
+	bool equivalent_shapat(const Handle& pattern,
+	                       const Valuations& valuations,
+	                       Handle& var, Handle& shapat) const;
+
+	/**
+	 * Return the maximum support to calculate, minsup() except in
+	 * top-k or CLOSED mode, where supports must be exact to be ranked
+	 * or compared, and remain valid as minsup() rises, or when mining
+	 * a lattice, the nodes of which hold exact supports.
+	 */
+	unsigned support_ms() const;
+
+	/**
+	 * Return the support of a frequent pattern, memoized or cached by
+	 * enough_support. It is exact if known, otherwise calculated up
+	 * to minsup.
+	 */
+	unsigned frequent_support(const Handle& pattern, const MinerDB& db) const;
+
+	/**
+	 * Pass pattern, reached from parent, to _sink with its support,
+	 * unless it has already been passed. claimed tells whether
+	 * pattern has just been claimed (see claim), which, unless the
+	 * depth is bounded, happens exactly once per pattern, so that
+	 * _emitted is not needed.
+	 */
+	void emit(const Handle& pattern, const Handle& parent,
+	          const MinerDB& db, bool claimed);
+
+	/**
+	 * Insert pattern, reached from parent, in _lattice, as well as
+	 * the edge between them.
+	 */
+	void insert_lattice(const Handle& pattern, const Handle& parent,
+	                    const MinerDB& db);
+
+	/**
+	 * Return true iff mined patterns are passed to _sink or _lattice
+	 * rather than returned.
+	 */
+	bool streaming() const;
+
+	/**
+	 * Reserve a job to explore a branch of the specialization tree
+	 * in its own thread. Return false if all param.jobs are already
+	 * in use, in which case the branch should be explored by the
+	 * calling thread.
+	 */
+	bool acquire_job();
+
+	/**
+	 * Release a job previously acquired with acquire_job.
+	 */
+	void release_job();
+
+	/**
+	 * Like specialize, but return the forest of patterns as built.
+	 */
+	HandleForest specialize_patterns(const Handle& pattern,
+	                                 const MinerDB& db,
+	                                 int maxdepth);
+	HandleForest specialize_patterns(const Handle& pattern,
+	                                 const MinerDB& db,
+	                                 const Valuations& valuations,
+	                                 int maxdepth);
+
+	/**
+	 * Specialize pattern, known to be frequent, from all variables
+	 * and by conjunction expansion, or, if equivalent_shapat finds
+	 * one, by its equivalent shallow abstraction only.
+	 */
+	HandleForest specialize_frequent(const Handle& pattern,
+	                                 const MinerDB& db,
+	                                 const Valuations& valuations,
+	                                 int maxdepth);
+
+	/**
+	 * Return true iff the specialization npat has enough conjuncts
+	 * and not too many variables to be mined.
+	 */
+	bool admissible(const Handle& npat) const;
+
 	/**
 	 * Return true iff maxdepth is null or pattern is not a lambda or
 	 * doesn't have enough support. Additionally the second one check
 	 * whether the valuation has any variable left to specialize from.
 	 */
 	bool terminate(const Handle& pattern,
-	               const HandleSeq& db,
+	               const MinerDB& db,
 	               const Valuations& valuations,
 	               int maxdepth) const;
 
@@ -155,30 +513,127 @@ private:
 	 * obtained by looking at the valuations of the front variable of
 	 * valuations, then recursively call Miner::specialize on these
 	 * obtained specializations.
+	 *
+	 * Each shallow abstraction gives an independent branch, which is
+	 * explored in its own thread if a job is available (see
+	 * MinerParameters::jobs). Branches are merged in the same order
+	 * regardless, so the result is deterministic.
 	 */
-	HandleTree specialize_shabs(const Handle& pattern,
-	                            const HandleSeq& db,
-	                            const Valuations& valuations,
-	                            int maxdepth);
+	HandleForest specialize_shabs(const Handle& pattern,
+	                              const MinerDB& db,
+	                              const Valuations& valuations,
+	                              int maxdepth);
 
 	/**
 	 * Specialize the given pattern with the given shallow abstraction
 	 * at the given variable, then call Miner::specialize on the
-	 * obtained specialization.
+	 * obtained specialization, with valuations derived from the
+	 * valuations of pattern (see Valuations::specialize), or if they
+	 * cannot be derived, with its support calculated over the
+	 * occurrences of pattern only (see Valuations::occurrences).
+	 */
+	HandleForest specialize_shapat(const Handle& pattern,
+	                               const MinerDB& db,
+	                               const Valuations& valuations,
+	                               const Handle& var,
+	                               const Handle& shapat,
+	                               int maxdepth);
+
+	/**
+	 * Given spe, a specialization of parent obtained by shallow
+	 * specialization or conjunction expansion, with svals its
+	 * valuations if they could be derived, or nullptr otherwise, put
+	 * it in canonical form, check that it has enough support, and if
+	 * it has not been explored yet, recursively specialize it. maxdepth
+	 * and pvals are the ones of parent. svals are renamed in place to
+	 * follow the canonical form (see Valuations::rename), rather than
+	 * copied.
+	 *
+	 * If svals is nullptr, the support and valuations of spe are
+	 * calculated by matching only the data trees where parent occurs,
+	 * if known from pvals. These occurrences are only built if the
+	 * support of spe is not already known (see enough_support).
+	 *
+	 * If _sink or _lattice is set, spe is passed to it and nothing is
+	 * returned.
+	 */
+	HandleForest specialize_spe(const Handle& spe,
+	                            const Handle& parent,
+	                            const MinerDB& db,
+	                            Valuations* svals,
+	                            int maxdepth,
+	                            const Valuations* pvals=nullptr);
+
+	/**
+	 * Specialize the given pattern by expanding its conjunction with
+	 * each frequent single conjunct pattern of _conjuncts, then
+	 * recursively specialize the obtained expansions. Nothing is
+	 * produced if the pattern is totally abstract or has already
+	 * param.maxconjuncts conjuncts.
 	 */
-	HandleTree specialize_shapat(const Handle& pattern,
-	                             const HandleSeq& db,
-	                             const Handle& var,
-	                             const Handle& shapat,
-	                             int maxdepth);
+	HandleForest specialize_cnjexp(const Handle& pattern,
+	                               const MinerDB& db,
+	                               int maxdepth);
+
+	/**
+	 * Fill _conjuncts with the frequent single conjunct patterns of
+	 * db, up to param.maxdepth, that are not totally abstract, if
+	 * conjunction expansion is enabled.
+	 */
+	void mine_conjuncts(const MinerDB& db);
+
+	/**
+	 * Return the key identifying the specializations of pattern up to
+	 * maxdepth, that is its canonical key, followed by maxdepth if
+	 * non-negative.
+	 */
+	std::string explored_key(const Handle& pattern, int maxdepth) const;
+
+	/**
+	 * Return true iff the specializations of pattern up to maxdepth
+	 * have not been explored yet, in which case they are marked as
+	 * explored, by the calling thread.
+	 */
+	bool claim(const Handle& pattern, int maxdepth);
+
+	/**
+	 * Given a forest of patterns produced from param.initpat, where
+	 * patterns already explored from another branch have no children
+	 * (see claim), remove all but the first occurrence, in pre-order,
+	 * of each pattern, and attach to it the children of its explored
+	 * occurrence. The result is thus independent of which branch
+	 * explored it first.
+	 */
+	HandleForest dedupe(const HandleForest& patterns) const;
+
+	/**
+	 * Helper of dedupe. Return the deduplicated forest made of the
+	 * given sibling patterns at the given depth.
+	 */
+	typedef std::unordered_map<std::string, const HandleForest::Node*,
+	                           CanonicalKeyHash> KeyNodeMap;
+	HandleForest dedupe(const std::vector<const HandleForest::Node*>& siblings,
+	                    int depth,
+	                    const KeyNodeMap& explored,
+	                    CanonicalKeySet& seen) const;
 
 	/**
 	 * Calculate if the pattern has enough support w.r.t. to the given
 	 * db, that is whether its frequency is greater than or equal
-	 * to minsup.
+	 * to minsup().
+	 *
+	 * The result is cached in _support_cache, so that patterns
+	 * reached from different branches are only evaluated once, and
+	 * patterns with an infrequent generalization (see
+	 * MinerUtils::generalizations) are rejected without calculating
+	 * their support. Supports of components are cached there as well,
+	 * and, if provided and known, only the data trees of occs are
+	 * matched (see MinerUtils::support). occs are only built if the
+	 * support must be calculated.
 	 */
 	bool enough_support(const Handle& pattern,
-	                    const HandleSeq& db) const;
+	                    const MinerDB& db,
+	                    LazyOccurrences* occs=nullptr) const;
 
 	/**
 	 * Given a pattern and a db, calculate the pattern support, that is
@@ -193,7 +648,7 @@ private:
 	 * certain maximum, for saving resources.
 	 */
 	unsigned support(const Handle& pattern,
-	                 const HandleSeq& db,
+	                 const MinerDB& db,
 	                 unsigned ms) const;
 
 	/**
@@ -206,7 +661,7 @@ private:
 	 * Filter in only db matching the pattern
 	 */
 	HandleSeq filter_db(const Handle& pattern,
-	                       const HandleSeq& db) const;
+	                       const MinerDB& db) const;
 
 	/**
 	 * Check whether a pattern matches a dt.
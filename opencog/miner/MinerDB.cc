@@ -0,0 +1,746 @@
+/*
+ * MinerDB.cc
+ *
+ * Copyright (C) 2026 OpenCog Foundation
+ *
+ * Author: agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "MinerDB.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <opencog/util/exceptions.h>
+#include <opencog/util/oc_assert.h>
+#include <opencog/atoms/base/Link.h>
+#include <opencog/atoms/base/Node.h>
+#include <opencog/atomspace/AtomSpace.h>
+
+namespace opencog
+{
+
+// Keys of the link index
+struct LinkKey
+{
+	Type type;
+	Arity arity;
+
+	bool operator==(const LinkKey& other) const
+	{
+		return type == other.type and arity == other.arity;
+	}
+};
+
+struct LinkChildKey
+{
+	Type type;
+	Arity pos;
+	ValueId child;
+
+	bool operator==(const LinkChildKey& other) const
+	{
+		return type == other.type and pos == other.pos
+			and child == other.child;
+	}
+};
+
+// Hash and equality of values by content, so that an atom of the data
+// trees and its copy in the db atomspace have the same identifier.
+struct ValueHash
+{
+	size_t operator()(const Handle& h) const
+	{
+		return h->get_hash();
+	}
+};
+
+struct ValueEqual
+{
+	bool operator()(const Handle& lhs, const Handle& rhs) const
+	{
+		return content_eq(lhs, rhs);
+	}
+};
+
+struct LinkKeyHash
+{
+	size_t operator()(const LinkKey& key) const
+	{
+		return std::hash<std::uint64_t>()
+			(((std::uint64_t)key.type << 48) ^ (std::uint64_t)key.arity);
+	}
+
+	size_t operator()(const LinkChildKey& key) const
+	{
+		return std::hash<std::uint64_t>()
+			(((std::uint64_t)key.type << 48)
+			 ^ ((std::uint64_t)key.pos << 32) ^ key.child);
+	}
+};
+
+// Contiguous buffer, either owned or pointing into a mapped file
+template<typename T>
+struct FlatBuffer
+{
+	std::vector<T> owned;
+	const T* ptr = nullptr;
+	size_t n = 0;
+
+	const T& operator[](size_t i) const { return ptr[i]; }
+	size_t size() const { return n; }
+
+	// Point to the owned buffer, to be called once filled
+	void own()
+	{
+		ptr = owned.data();
+		n = owned.size();
+	}
+};
+
+// Read only memory mapping of a file
+struct MappedFile
+{
+	MappedFile(const std::string& filename) : addr(nullptr), length(0)
+	{
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw RuntimeException(TRACE_INFO, "Cannot open db file %s",
+			                       filename.c_str());
+		struct stat st;
+		if (fstat(fd, &st) < 0) {
+			::close(fd);
+			throw RuntimeException(TRACE_INFO, "Cannot stat db file %s",
+			                       filename.c_str());
+		}
+		length = st.st_size;
+		void* map = length ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0)
+			: MAP_FAILED;
+		::close(fd);
+		if (map == MAP_FAILED)
+			throw RuntimeException(TRACE_INFO, "Cannot map db file %s",
+			                       filename.c_str());
+		addr = static_cast<const char*>(map);
+	}
+
+	~MappedFile()
+	{
+		munmap(const_cast<char*>(addr), length);
+	}
+
+	const char* addr;
+	size_t length;
+};
+
+// Layout of db files, all sections following the header are aligned
+// on 8 bytes, see MinerDB::save.
+struct FileHeader
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t n_types;
+	std::uint64_t n_roots;
+	std::uint64_t n_values;
+	std::uint64_t n_children;
+	std::uint64_t n_preorder;
+	std::uint64_t type_names_size;
+	std::uint64_t names_size;
+};
+
+static const char db_file_magic[8] = {'O', 'C', 'M', 'I', 'N', 'E', 'D', 'B'};
+static const std::uint32_t db_file_version = 1;
+
+static void write_padding(std::ostream& out, size_t size)
+{
+	static const char zeros[8] = {0};
+	if (size % 8)
+		out.write(zeros, 8 - size % 8);
+}
+
+template<typename T>
+static void write_section(std::ostream& out, const T* ptr, size_t n)
+{
+	out.write(reinterpret_cast<const char*>(ptr), n * sizeof(T));
+	write_padding(out, n * sizeof(T));
+}
+
+template<typename T>
+static const T* read_section(const char*& cur, const char* end, size_t n)
+{
+	size_t size = n * sizeof(T), padded = (size + 7) / 8 * 8;
+	if ((size_t)(end - cur) < padded)
+		throw RuntimeException(TRACE_INFO, "Truncated db file");
+	const T* section = reinterpret_cast<const T*>(cur);
+	cur += padded;
+	return section;
+}
+
+template<typename T>
+static void map_section(FlatBuffer<T>& buffer, const char*& cur,
+                        const char* end, size_t n)
+{
+	buffer.ptr = read_section<T>(cur, end, n);
+	buffer.n = n;
+}
+
+struct MinerDB::Data
+{
+	Data(const HandleSeq& db) : id(++last_id), roots(db), mapped(false) {}
+
+	// Runtime type of the value of identifier id
+	Type type(ValueId id) const
+	{
+		Type t = value_types[id];
+		return type_map.empty() ? t : type_map[t];
+	}
+
+	// Identifier of the db, see MinerDB::id
+	static std::atomic<std::uint64_t> last_id;
+	const std::uint64_t id;
+
+	// Data trees, materialized lazily by roots if mapped
+	HandleSeq roots;
+	std::once_flag roots_flag;
+
+	// File the flat encodings are mapped from, if any
+	bool mapped;
+	std::unique_ptr<MappedFile> file;
+
+	// Map the types of a mapped file to runtime types, empty if they
+	// are the same.
+	std::vector<Type> type_map;
+
+	// Atomspace copy, built lazily by atomspace
+	std::once_flag as_flag;
+	std::unique_ptr<AtomSpace> as;
+	HandleSeq as_roots;
+
+	// Value dictionary, built lazily by valued_data
+	std::once_flag value_flag;
+	std::unordered_map<Handle, ValueId, ValueHash, ValueEqual> value_ids;
+	HandleSeq id_values;
+
+	// Flat encoding of values, built lazily by flat_data, or mapped.
+	// The outgoings of the value of identifier id range from
+	// value_children[value_offsets[id]] to
+	// value_children[value_offsets[id + 1]], excluded. Node names are
+	// only mapped, from names[name_offsets[id]] to
+	// names[name_offsets[id + 1]], excluded.
+	std::once_flag flat_flag;
+	FlatBuffer<std::uint32_t> value_types;
+	FlatBuffer<std::uint32_t> value_offsets;
+	FlatBuffer<ValueId> value_children;
+	FlatBuffer<std::uint64_t> name_offsets;
+	FlatBuffer<char> names;
+
+	// Flat encoding of data trees, built lazily by flat_data, or
+	// mapped
+	FlatBuffer<ValueId> preorder;
+	FlatBuffer<std::uint32_t> subtree_sizes;
+	FlatBuffer<std::uint64_t> tree_offsets;
+
+	// Data trees containing each value, built lazily by rooted_data
+	std::once_flag value_roots_flag;
+	std::vector<IndexSeq> value_roots;
+
+	// Data trees containing each link type and arity, and each link
+	// type and child, built lazily by rooted_data
+	std::unordered_map<LinkKey, IndexSeq, LinkKeyHash> link_roots;
+	std::unordered_map<LinkChildKey, IndexSeq, LinkKeyHash> link_child_roots;
+};
+
+// Append i to roots unless it is already its last index
+static void push_root(MinerDB::IndexSeq& roots, unsigned i)
+{
+	if (roots.empty() or roots.back() != i)
+		roots.push_back(i);
+}
+
+const unsigned MinerDB::npos;
+
+std::atomic<std::uint64_t> MinerDB::Data::last_id(0);
+
+MinerDB::MinerDB() : MinerDB(HandleSeq()) {}
+
+MinerDB::MinerDB(const HandleSeq& db) : _data(std::make_shared<Data>(db)) {}
+
+MinerDB::MinerDB(const AtomSpace& db_as)
+{
+	HandleSeq db;
+	db_as.get_handles_by_type(std::inserter(db, db.end()),
+	                          opencog::ATOM, true);
+	_data = std::make_shared<Data>(db);
+}
+
+void MinerDB::save(const std::string& filename) const
+{
+	const Data& data = flat_data();
+	const Data& vdata = valued_data();
+	size_t n_values = vdata.id_values.size();
+
+	// Runtime types of values, and the names of the types in use
+	std::vector<std::uint32_t> types(n_values);
+	std::vector<std::uint32_t> used_types;
+	std::string type_names;
+	for (ValueId id = 0; id < n_values; id++) {
+		types[id] = data.type(id);
+		if (std::find(used_types.begin(), used_types.end(), types[id])
+		    == used_types.end()) {
+			used_types.push_back(types[id]);
+			type_names += nameserver().getTypeName(types[id]);
+			type_names.push_back('\0');
+		}
+	}
+
+	// Node names
+	std::vector<std::uint64_t> name_offsets{0};
+	std::string names;
+	for (const Handle& h : vdata.id_values) {
+		if (h->is_node())
+			names += h->get_name();
+		name_offsets.push_back(names.size());
+	}
+
+	FileHeader header;
+	std::memcpy(header.magic, db_file_magic, sizeof(header.magic));
+	header.version = db_file_version;
+	header.n_types = used_types.size();
+	header.n_roots = size();
+	header.n_values = n_values;
+	header.n_children = data.value_children.size();
+	header.n_preorder = data.preorder.size();
+	header.type_names_size = type_names.size();
+	header.names_size = names.size();
+
+	std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+	if (not out)
+		throw RuntimeException(TRACE_INFO, "Cannot write db file %s",
+		                       filename.c_str());
+	write_section(out, &header, 1);
+	write_section(out, used_types.data(), used_types.size());
+	write_section(out, type_names.data(), type_names.size());
+	write_section(out, types.data(), types.size());
+	write_section(out, data.value_offsets.ptr, data.value_offsets.size());
+	write_section(out, data.value_children.ptr, data.value_children.size());
+	write_section(out, name_offsets.data(), name_offsets.size());
+	write_section(out, names.data(), names.size());
+	write_section(out, data.tree_offsets.ptr, data.tree_offsets.size());
+	write_section(out, data.preorder.ptr, data.preorder.size());
+	write_section(out, data.subtree_sizes.ptr, data.subtree_sizes.size());
+	if (not out)
+		throw RuntimeException(TRACE_INFO, "Cannot write db file %s",
+		                       filename.c_str());
+}
+
+MinerDB MinerDB::open(const std::string& filename)
+{
+	MinerDB db;
+	Data& data = *db._data;
+	data.file.reset(new MappedFile(filename));
+	const char* cur = data.file->addr;
+	const char* end = cur + data.file->length;
+
+	const FileHeader& header = *read_section<FileHeader>(cur, end, 1);
+	if (std::memcmp(header.magic, db_file_magic, sizeof(header.magic))
+	    or header.version != db_file_version)
+		throw RuntimeException(TRACE_INFO, "%s is not a valid db file",
+		                       filename.c_str());
+
+	// Map the types of the file to the runtime ones
+	const std::uint32_t* file_types =
+		read_section<std::uint32_t>(cur, end, header.n_types);
+	const char* type_name =
+		read_section<char>(cur, end, header.type_names_size);
+	const char* type_names_end = type_name + header.type_names_size;
+	std::vector<std::pair<std::uint32_t, Type>> file2types;
+	bool same_types = true;
+	for (std::uint32_t i = 0; i < header.n_types; i++) {
+		if (type_name >= type_names_end)
+			throw RuntimeException(TRACE_INFO, "Truncated db file");
+		Type t = nameserver().getType(type_name);
+		if (t == NOTYPE)
+			throw RuntimeException(TRACE_INFO, "Unknown type %s in db file %s",
+			                       type_name, filename.c_str());
+		file2types.push_back({file_types[i], t});
+		same_types = same_types and file_types[i] == t;
+		type_name += std::strlen(type_name) + 1;
+	}
+	if (not same_types) {
+		for (const auto& ft : file2types) {
+			if (data.type_map.size() <= ft.first)
+				data.type_map.resize(ft.first + 1, NOTYPE);
+			data.type_map[ft.first] = ft.second;
+		}
+	}
+
+	// Map the flat encodings
+	map_section(data.value_types, cur, end, header.n_values);
+	map_section(data.value_offsets, cur, end, header.n_values + 1);
+	map_section(data.value_children, cur, end, header.n_children);
+	map_section(data.name_offsets, cur, end, header.n_values + 1);
+	map_section(data.names, cur, end, header.names_size);
+	map_section(data.tree_offsets, cur, end, header.n_roots + 1);
+	map_section(data.preorder, cur, end, header.n_preorder);
+	map_section(data.subtree_sizes, cur, end, header.n_preorder);
+	data.mapped = true;
+
+	return db;
+}
+
+HandleSeq MinerDB::load(AtomSpace& as) const
+{
+	const Data& data = *_data;
+	if (data.mapped)
+		return build_roots(data, &as);
+
+	HandleSeq dts;
+	dts.reserve(size());
+	for (const Handle& dt : data.roots)
+		dts.push_back(as.add_atom(dt));
+	return dts;
+}
+
+size_t MinerDB::size() const
+{
+	return _data->mapped ? _data->tree_offsets.size() - 1 : _data->roots.size();
+}
+
+bool MinerDB::empty() const
+{
+	return size() == 0;
+}
+
+std::uint64_t MinerDB::id() const
+{
+	return _data->id;
+}
+
+const Handle& MinerDB::operator[](size_t i) const
+{
+	return roots()[i];
+}
+
+MinerDB::const_iterator MinerDB::begin() const
+{
+	return roots().begin();
+}
+
+MinerDB::const_iterator MinerDB::end() const
+{
+	return roots().end();
+}
+
+const HandleSeq& MinerDB::handles() const
+{
+	return roots();
+}
+
+AtomSpace& MinerDB::atomspace() const
+{
+	const HandleSeq& dts = roots();
+	Data& data = *_data;
+	std::call_once(data.as_flag, [&]() {
+			data.as.reset(new AtomSpace());
+			data.as_roots.reserve(dts.size());
+			for (const Handle& dt : dts)
+				data.as_roots.push_back(data.as->add_atom(dt));
+		});
+	return *data.as;
+}
+
+const HandleSeq& MinerDB::atomspace_handles() const
+{
+	atomspace();
+	return _data->as_roots;
+}
+
+ValueId MinerDB::value_id(const Handle& value) const
+{
+	const Data& data = valued_data();
+	auto it = data.value_ids.find(value);
+	return it == data.value_ids.end() ? npos : it->second;
+}
+
+const Handle& MinerDB::value(ValueId id) const
+{
+	return valued_data().id_values[id];
+}
+
+size_t MinerDB::n_values() const
+{
+	return flat_data().value_types.size();
+}
+
+Type MinerDB::value_type(ValueId id) const
+{
+	return flat_data().type(id);
+}
+
+Arity MinerDB::value_arity(ValueId id) const
+{
+	const Data& data = flat_data();
+	return data.value_offsets[id + 1] - data.value_offsets[id];
+}
+
+ValueId MinerDB::value_child(ValueId id, Arity pos) const
+{
+	const Data& data = flat_data();
+	return data.value_children[data.value_offsets[id] + pos];
+}
+
+ValueId MinerDB::preorder(size_t pos) const
+{
+	return flat_data().preorder[pos];
+}
+
+size_t MinerDB::tree_offset(size_t i) const
+{
+	return flat_data().tree_offsets[i];
+}
+
+std::uint32_t MinerDB::subtree_size(size_t pos) const
+{
+	return flat_data().subtree_sizes[pos];
+}
+
+const MinerDB::IndexSeq& MinerDB::value_roots(ValueId id) const
+{
+	return rooted_data().value_roots[id];
+}
+
+const MinerDB::IndexSeq& MinerDB::link_roots(Type t, Arity arity) const
+{
+	static const IndexSeq empty_index;
+	const Data& data = rooted_data();
+	auto it = data.link_roots.find({t, arity});
+	return it == data.link_roots.end() ? empty_index : it->second;
+}
+
+const MinerDB::IndexSeq& MinerDB::link_roots(Type t, Arity pos,
+                                             ValueId child) const
+{
+	static const IndexSeq empty_index;
+	const Data& data = rooted_data();
+	auto it = data.link_child_roots.find({t, pos, child});
+	return it == data.link_child_roots.end() ? empty_index : it->second;
+}
+
+const HandleSeq& MinerDB::roots() const
+{
+	Data& data = *_data;
+	if (not data.mapped)
+		return data.roots;
+
+	std::call_once(data.roots_flag, [&]() {
+			data.roots = build_roots(data, nullptr);
+		});
+	return data.roots;
+}
+
+HandleSeq MinerDB::build_roots(const Data& data, AtomSpace* as)
+{
+	// Build each value once, children first. The subtrees of the
+	// outgoings of a link immediately follow it in preorder, so going
+	// backward builds them first.
+	HandleSeq values(data.value_types.size());
+	for (size_t pos = data.preorder.size(); pos-- > 0;) {
+		ValueId id = data.preorder[pos];
+		if (values[id])
+			continue;
+		Type t = data.type(id);
+		if (nameserver().isNode(t)) {
+			const char* name = data.names.ptr + data.name_offsets[id];
+			size_t length = data.name_offsets[id + 1] - data.name_offsets[id];
+			std::string sname(name, length);
+			values[id] = as ? as->add_node(t, std::move(sname))
+				: Handle(createNode(t, std::move(sname)));
+		} else {
+			HandleSeq outs;
+			outs.reserve(data.value_offsets[id + 1] - data.value_offsets[id]);
+			for (auto i = data.value_offsets[id];
+			     i < data.value_offsets[id + 1]; i++)
+				outs.push_back(values[data.value_children[i]]);
+			values[id] = as ? as->add_link(t, std::move(outs))
+				: Handle(createLink(std::move(outs), t));
+		}
+	}
+
+	HandleSeq roots;
+	roots.reserve(data.tree_offsets.size() - 1);
+	for (size_t i = 0; i + 1 < data.tree_offsets.size(); i++)
+		roots.push_back(values[data.preorder[data.tree_offsets[i]]]);
+	return roots;
+}
+
+const MinerDB::Data& MinerDB::valued_data() const
+{
+	const HandleSeq& dts = roots();
+	Data& data = *_data;
+	std::call_once(data.value_flag, [&]() {
+			// Traverse the data trees, assigning identifiers to
+			// atoms in order of first encounter. If mapped, since
+			// the data trees are the same, so are the identifiers.
+			HandleSeq to_visit(dts.rbegin(), dts.rend());
+			while (not to_visit.empty()) {
+				Handle h = to_visit.back();
+				to_visit.pop_back();
+				ValueId id = data.id_values.size();
+				if (not data.value_ids.insert({h, id}).second)
+					continue;
+				data.id_values.push_back(h);
+				if (h->is_link()) {
+					const HandleSeq& outs = h->getOutgoingSet();
+					to_visit.insert(to_visit.end(), outs.rbegin(), outs.rend());
+				}
+			}
+			OC_ASSERT(not data.mapped or
+			          data.id_values.size() == data.value_types.size(),
+			          "Mapped values do not match their data trees");
+		});
+	return data;
+}
+
+const MinerDB::Data& MinerDB::flat_data() const
+{
+	Data& data = *_data;
+	if (data.mapped)
+		return data;
+
+	std::call_once(data.flat_flag, [&]() {
+			valued_data();
+
+			// Encode the types and outgoings of values
+			size_t n_values = data.id_values.size();
+			data.value_types.owned.reserve(n_values);
+			data.value_offsets.owned.reserve(n_values + 1);
+			data.value_offsets.owned.push_back(0);
+			for (const Handle& h : data.id_values) {
+				data.value_types.owned.push_back(h->get_type());
+				if (h->is_link())
+					for (const Handle& out : h->getOutgoingSet())
+						data.value_children.owned.push_back(data.value_ids.at(out));
+				data.value_offsets.owned.push_back(data.value_children.owned.size());
+			}
+			data.value_types.own();
+			data.value_offsets.own();
+			data.value_children.own();
+
+			// Lay out the data trees in preorder
+			std::vector<std::uint64_t>& tree_offsets = data.tree_offsets.owned;
+			ValueIdSeq& preorder = data.preorder.owned;
+			tree_offsets.reserve(data.roots.size() + 1);
+			for (const Handle& dt : data.roots) {
+				tree_offsets.push_back(preorder.size());
+				ValueIdSeq to_visit{data.value_ids.at(dt)};
+				while (not to_visit.empty()) {
+					ValueId id = to_visit.back();
+					to_visit.pop_back();
+					preorder.push_back(id);
+					const ValueId* outs = data.value_children.ptr;
+					to_visit.insert(to_visit.end(),
+					                std::reverse_iterator<const ValueId*>
+					                (outs + data.value_offsets[id + 1]),
+					                std::reverse_iterator<const ValueId*>
+					                (outs + data.value_offsets[id]));
+				}
+			}
+			tree_offsets.push_back(preorder.size());
+			data.tree_offsets.own();
+			data.preorder.own();
+
+			// Calculate subtree sizes, children first. The subtrees of
+			// the outgoings of a link immediately follow it.
+			std::vector<std::uint32_t>& subtree_sizes = data.subtree_sizes.owned;
+			subtree_sizes.resize(preorder.size());
+			for (size_t pos = preorder.size(); pos-- > 0;) {
+				ValueId id = preorder[pos];
+				std::uint32_t size = 1;
+				size_t child_pos = pos + 1;
+				for (auto i = data.value_offsets[id];
+				     i < data.value_offsets[id + 1]; i++) {
+					size += subtree_sizes[child_pos];
+					child_pos += subtree_sizes[child_pos];
+				}
+				subtree_sizes[pos] = size;
+			}
+			data.subtree_sizes.own();
+		});
+	return data;
+}
+
+const MinerDB::Data& MinerDB::rooted_data() const
+{
+	flat_data();
+	Data& data = *_data;
+	std::call_once(data.value_roots_flag, [&]() {
+			// Scan the preorder layout of each data tree
+			size_t n_roots = data.tree_offsets.size() - 1;
+			data.value_roots.resize(data.value_types.size());
+			for (unsigned i = 0; i < n_roots; i++) {
+				size_t pos = data.tree_offsets[i];
+				while (pos < data.tree_offsets[i + 1]) {
+					ValueId id = data.preorder[pos];
+					IndexSeq& roots = data.value_roots[id];
+					// Already reached from that data tree, and so is its
+					// subtree
+					if (not roots.empty() and roots.back() == i) {
+						pos += data.subtree_sizes[pos];
+						continue;
+					}
+					roots.push_back(i);
+					Type t = data.type(id);
+					if (nameserver().isLink(t)) {
+						std::uint32_t begin = data.value_offsets[id],
+							arity = data.value_offsets[id + 1] - begin;
+						push_root(data.link_roots[{t, arity}], i);
+						for (Arity p = 0; p < arity; p++) {
+							ValueId child = data.value_children[begin + p];
+							push_root(data.link_child_roots[{t, p, child}], i);
+						}
+					}
+					pos++;
+				}
+			}
+		});
+	return data;
+}
+
+std::string MinerDB::to_string(const std::string& indent) const
+{
+	std::stringstream ss;
+	ss << indent << "size = " << size() << std::endl
+	   << oc_to_string(handles(), indent + OC_TO_STRING_INDENT);
+	return ss.str();
+}
+
+std::string oc_to_string(const MinerDB& db, const std::string& indent)
+{
+	return db.to_string(indent);
+}
+
+} // namespace opencog
@@ -0,0 +1,293 @@
+/*
+ * MinerDB.h
+ *
+ * Copyright (C) 2026 OpenCog Foundation
+ *
+ * Author: agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef OPENCOG_MINER_DB_H_
+#define OPENCOG_MINER_DB_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <opencog/util/empty_string.h>
+#include <opencog/atoms/base/Handle.h>
+#include <opencog/atoms/base/Atom.h>
+
+namespace opencog
+{
+
+class AtomSpace;
+
+/**
+ * Identifier of an atom of a MinerDB, data tree or subtree, see
+ * MinerDB::value_id.
+ */
+typedef std::uint32_t ValueId;
+typedef std::vector<ValueId> ValueIdSeq;
+
+/**
+ * Collection of data trees to mine, a.k.a. db. It is built once,
+ * from a sequence of data trees or an atomspace, then shared, read
+ * only, by all the miner functions taking a db.
+ *
+ * Beside the data trees themselves it holds
+ *
+ * 1. An atomspace containing a copy of the data trees, and nothing
+ *    else, to run the pattern matcher over.
+ * 2. A value dictionary, mapping each atom of the data trees, thus
+ *    any value a variable can take, to a 32-bit identifier and back.
+ *    Atoms are mapped by content, so that the copies of atomspace()
+ *    have the same identifiers, though building it does not require
+ *    atomspace().
+ *    Along with a flat encoding of these atoms, that is their types,
+ *    arities and outgoing identifiers in contiguous 32-bit buffers, so
+ *    that they can be inspected without going through handles.
+ * 3. An occurrence index, mapping each value identifier to the
+ *    indices of the data trees containing it.
+ * 4. A link index, mapping each link type and arity, and each link
+ *    type, position and child value, to the indices of the data trees
+ *    containing such a link, either as a subtree or as themselves.
+ *    Used to narrow down the data trees a pattern may match (see
+ *    MinerUtils::candidates).
+ * 5. A flat encoding of the data trees, that is the identifiers of
+ *    their atoms in preorder, in a single contiguous buffer, along
+ *    with the size of the subtree starting at each position.
+ *
+ * All of them are built lazily, upon first use, in a thread safe
+ * manner. Copying a MinerDB is cheap as copies share the same data
+ * trees and indices.
+ *
+ * A db can be saved into a binary file holding its flat encodings,
+ * then opened by memory mapping that file (see save and open).
+ */
+class MinerDB
+{
+public:
+	typedef std::vector<unsigned> IndexSeq;
+	typedef HandleSeq::const_iterator const_iterator;
+
+	/**
+	 * Identifier returned by value_id for atoms not in db.
+	 */
+	static const unsigned npos = (unsigned)-1;
+
+	/**
+	 * CTors. Each db built from a HandleSeq or an atomspace has its
+	 * own id() and indices, thus should be built once and passed
+	 * around, rather than rebuilt at each call.
+	 */
+	MinerDB();
+	explicit MinerDB(const HandleSeq& db);
+	explicit MinerDB(const AtomSpace& db_as);
+
+	/**
+	 * Write db into the given file, that is its flat encodings (see
+	 * value_type and preorder), node names and type names, in a
+	 * binary format meant to be memory mapped by open.
+	 *
+	 * Throw a RuntimeException if the file cannot be written.
+	 */
+	void save(const std::string& filename) const;
+
+	/**
+	 * Open a db saved by save. The file is memory mapped read only,
+	 * so the flat encodings, as well as the indices built from them,
+	 * are read from it directly and paged in on demand, rather than
+	 * loaded. Handles, that is the data trees and the atomspace
+	 * holding them, are only materialized from it upon first use,
+	 * such as by handles() or atomspace().
+	 *
+	 * Throw a RuntimeException if the file cannot be opened or is not
+	 * a valid db file.
+	 */
+	static MinerDB open(const std::string& filename);
+
+	/**
+	 * Add the data trees of db to as and return them, as added, in
+	 * the same order as handles(). If db is opened from a file, the
+	 * atoms are directly built into as from the flat encodings, in a
+	 * single pass, without materializing the data trees of db. Thus
+	 *
+	 * MinerDB::open(filename).load(as);
+	 *
+	 * bulk loads a snapshot saved by save, with no need to parse its
+	 * original scheme corpus.
+	 */
+	HandleSeq load(AtomSpace& as) const;
+
+	/**
+	 * Return the number of data trees.
+	 */
+	size_t size() const;
+
+	/**
+	 * Return true iff db has no data tree.
+	 */
+	bool empty() const;
+
+	/**
+	 * Return an identifier of db, shared by its copies, and never
+	 * given to another db, even once db is destroyed. Never 0.
+	 */
+	std::uint64_t id() const;
+
+	/**
+	 * Access data trees.
+	 */
+	const Handle& operator[](size_t i) const;
+	const_iterator begin() const;
+	const_iterator end() const;
+	const HandleSeq& handles() const;
+
+	/**
+	 * Return the atomspace containing a copy of the data trees (and
+	 * their subtrees), and nothing else.
+	 */
+	AtomSpace& atomspace() const;
+
+	/**
+	 * Return the data trees as inserted in atomspace(), in the same
+	 * order as handles().
+	 */
+	const HandleSeq& atomspace_handles() const;
+
+	/**
+	 * Return the identifier of an atom of the data trees, or of its
+	 * copy in atomspace(), or npos if there is no such atom.
+	 * Identifiers range from 0 to n_values() - 1.
+	 */
+	ValueId value_id(const Handle& value) const;
+
+	/**
+	 * Return the atom of the data trees corresponding to the given
+	 * identifier.
+	 */
+	const Handle& value(ValueId id) const;
+
+	/**
+	 * Return the number of distinct atoms in the data trees.
+	 */
+	size_t n_values() const;
+
+	/**
+	 * Return the type of the atom of the given identifier.
+	 */
+	Type value_type(ValueId id) const;
+
+	/**
+	 * Return the arity of the atom of the given identifier. Nodes
+	 * have arity 0.
+	 */
+	Arity value_arity(ValueId id) const;
+
+	/**
+	 * Return the identifier of the outgoing at position pos of the
+	 * link of the given identifier.
+	 */
+	ValueId value_child(ValueId id, Arity pos) const;
+
+	/**
+	 * Return the identifier of the atom at position pos of the
+	 * preorder layout of all data trees, each data tree in preorder,
+	 * one after the other.
+	 */
+	ValueId preorder(size_t pos) const;
+
+	/**
+	 * Return the position in the preorder layout of the i-th data
+	 * tree. If i is the number of data trees, return the size of the
+	 * layout.
+	 */
+	size_t tree_offset(size_t i) const;
+
+	/**
+	 * Return the size of the subtree starting at position pos of the
+	 * preorder layout, that is the number of atoms it contains,
+	 * itself included.
+	 */
+	std::uint32_t subtree_size(size_t pos) const;
+
+	/**
+	 * Return the indices, in increasing order, of the data trees
+	 * containing the atom of the given identifier, either as a
+	 * subtree or as themselves.
+	 */
+	const IndexSeq& value_roots(ValueId id) const;
+
+	/**
+	 * Return the indices, in increasing order, of the data trees
+	 * containing a link of type t and of the given arity.
+	 */
+	const IndexSeq& link_roots(Type t, Arity arity) const;
+
+	/**
+	 * Return the indices, in increasing order, of the data trees
+	 * containing a link of type t with, at position pos, the atom of
+	 * the given identifier.
+	 */
+	const IndexSeq& link_roots(Type t, Arity pos, ValueId child) const;
+
+	std::string to_string(const std::string& indent=empty_string) const;
+
+private:
+	struct Data;
+
+	/**
+	 * Materialize the data trees from the flat encodings if the db is
+	 * mapped from a file, and return them.
+	 */
+	const HandleSeq& roots() const;
+
+	/**
+	 * Build the data trees from the flat encodings of a mapped db,
+	 * adding them to as if not null.
+	 */
+	static HandleSeq build_roots(const Data& data, AtomSpace* as);
+
+	/**
+	 * Build the value dictionary, if not already built.
+	 */
+	const Data& valued_data() const;
+
+	/**
+	 * Build the flat encodings of values and data trees, if not
+	 * already built or mapped from a file.
+	 */
+	const Data& flat_data() const;
+
+	/**
+	 * Build the data trees containing each value, and the link index,
+	 * if not already built.
+	 */
+	const Data& rooted_data() const;
+
+	std::shared_ptr<Data> _data;
+};
+
+std::string oc_to_string(const MinerDB& db,
+                         const std::string& indent=empty_string);
+
+} // ~namespace opencog
+
+#endif /* OPENCOG_MINER_DB_H_ */
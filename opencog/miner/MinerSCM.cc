@@ -23,12 +23,16 @@
 
 #ifdef HAVE_GUILE
 
+#include <climits>
 #include <cmath>
+#include <list>
+#include <mutex>
 
 #include <opencog/util/Logger.h>
 #include <opencog/guile/SchemeModule.h>
 #include <opencog/atoms/core/NumberNode.h>
 
+#include "MinerDB.h"
 #include "MinerUtils.h"
 #include "Surprisingness.h"
 
@@ -101,6 +105,32 @@ protected:
 	Handle do_expand_conjunction(Handle cnjtion, Handle pattern, Handle db,
 	                             Handle ms, Handle mv, bool es);
 
+	/**
+	 * Given a set of patterns, a db concept and a minimum support,
+	 * return the subset of patterns that are closed, that is with no
+	 * specialization of equal support, or maximal, that is with no
+	 * specialization reaching the minimum support.
+	 *
+	 * Specializations are shallow specializations, and expansions of
+	 * conjunctions with the single conjunct patterns of the set.
+	 *
+	 * mc is the maximum number of conjuncts
+	 * mv is the maximum of variables
+	 * es is a flag to enforce specialization
+	 */
+	Handle do_closed_patterns(Handle patterns, Handle db, Handle ms,
+	                          Handle mc, Handle mv, bool es);
+	Handle do_maximal_patterns(Handle patterns, Handle db, Handle ms,
+	                           Handle mc, Handle mv, bool es);
+
+	/**
+	 * Helper of do_closed_patterns and do_maximal_patterns.
+	 */
+	Handle select_patterns(const char* fname, bool maximal,
+	                       const Handle& patterns, const Handle& db,
+	                       const Handle& ms_h, const Handle& mc_h,
+	                       const Handle& mv_h, bool es);
+
 	/**
 	 * Calculate the I-Surprisingness of the pattern (and its
 	 * partitions) with respect to db.
@@ -130,6 +160,20 @@ protected:
 	 */
 	double do_jsd(TruthValuePtr ltv, TruthValuePtr rtv);
 
+	/**
+	 * Given a db concept node, return the MinerDB of its members. It
+	 * is built once and cached, and only rebuilt if the members of
+	 * db_cpt have changed since.
+	 *
+	 * Only the max_dbs most recently used dbs are cached, and dbs
+	 * of concepts removed from their atomspace are discarded.
+	 */
+	MinerDB get_db(const Handle& db_cpt);
+
+	static const size_t max_dbs = 4;
+	std::mutex _dbs_mtx;
+	std::list<std::pair<Handle, MinerDB>> _dbs;
+
 public:
 	MinerSCM();
 };
@@ -161,6 +205,12 @@ void MinerSCM::init(void)
 	define_scheme_primitive("cog-expand-conjunction",
 		&MinerSCM::do_expand_conjunction, this, "miner");
 
+	define_scheme_primitive("cog-closed-patterns",
+		&MinerSCM::do_closed_patterns, this, "miner");
+
+	define_scheme_primitive("cog-maximal-patterns",
+		&MinerSCM::do_maximal_patterns, this, "miner");
+
 	define_scheme_primitive("cog-isurp-old",
 		&MinerSCM::do_isurp_old, this, "miner");
 
@@ -190,14 +240,14 @@ Handle MinerSCM::do_shallow_abstract(Handle pattern,
 	AtomSpace *as = SchemeSmob::ss_get_env_as("cog-shallow-abstract");
 
 	// Fetch data trees
-	HandleSeq db_seq = MinerUtils::get_db(db);
+	MinerDB mdb = get_db(db);
 
 	// Fetch the minimum support
 	unsigned ms = MinerUtils::get_uint(ms_h);
 
 	// Generate all shallow abstractions
 	HandleSetSeq shabs_per_var =
-		MinerUtils::shallow_abstract(pattern, db_seq, ms);
+		MinerUtils::shallow_abstract(pattern, mdb, ms);
 
 	// Turn that sequence of handle sets into a set of ready to be
 	// applied shallow abstractions
@@ -227,14 +277,14 @@ Handle MinerSCM::do_shallow_specialize(Handle pattern,
 	AtomSpace *as = SchemeSmob::ss_get_env_as("cog-shallow-specialize");
 
 	// Fetch data trees
-	HandleSeq db_seq = MinerUtils::get_db(db);
+	MinerDB mdb = get_db(db);
 
 	// Get minimum support and maximum number of variables
 	unsigned ms = MinerUtils::get_uint(ms_h);
 	unsigned mv = MinerUtils::get_uint(mv_h);
 
 	// Generate all shallow specializations
-	HandleSet shaspes = MinerUtils::shallow_specialize(pattern, db_seq, ms, mv);
+	HandleSet shaspes = MinerUtils::shallow_specialize(pattern, mdb, ms, mv);
 
 	return as->add_link(SET_LINK, HandleSeq(shaspes.begin(), shaspes.end()));
 }
@@ -242,12 +292,12 @@ Handle MinerSCM::do_shallow_specialize(Handle pattern,
 bool MinerSCM::do_enough_support(Handle pattern, Handle db, Handle ms_h)
 {
 	// Fetch data trees
-	HandleSeq db_seq = MinerUtils::get_db(db);
+	MinerDB mdb = get_db(db);
 
 	// Fetch the minimum support
 	unsigned ms = MinerUtils::get_uint(ms_h);
 
-	return MinerUtils::enough_support(pattern, db_seq, ms);
+	return MinerUtils::enough_support(pattern, mdb, ms);
 }
 
 Handle MinerSCM::do_expand_conjunction(Handle cnjtion, Handle pattern,
@@ -257,65 +307,115 @@ Handle MinerSCM::do_expand_conjunction(Handle cnjtion, Handle pattern,
 	AtomSpace *as = SchemeSmob::ss_get_env_as("cog-expand-conjunction");
 
 	// Fetch data trees
-	HandleSeq db_seq = MinerUtils::get_db(db);
+	MinerDB mdb = get_db(db);
 
 	// Get minimum support and maximum variables
 	unsigned ms = MinerUtils::get_uint(ms_h);
 	unsigned mv = MinerUtils::get_uint(mv_h);
 
 	HandleSet results = MinerUtils::expand_conjunction(cnjtion, pattern,
-	                                                   db_seq, ms, mv, es);
+	                                                   mdb, ms, mv, es);
 	return as->add_link(SET_LINK, HandleSeq(results.begin(), results.end()));
 }
 
+Handle MinerSCM::do_closed_patterns(Handle patterns, Handle db, Handle ms_h,
+                                    Handle mc_h, Handle mv_h, bool es)
+{
+	return select_patterns("cog-closed-patterns", false,
+	                       patterns, db, ms_h, mc_h, mv_h, es);
+}
+
+Handle MinerSCM::do_maximal_patterns(Handle patterns, Handle db, Handle ms_h,
+                                     Handle mc_h, Handle mv_h, bool es)
+{
+	return select_patterns("cog-maximal-patterns", true,
+	                       patterns, db, ms_h, mc_h, mv_h, es);
+}
+
+Handle MinerSCM::select_patterns(const char* fname, bool maximal,
+                                 const Handle& patterns, const Handle& db,
+                                 const Handle& ms_h, const Handle& mc_h,
+                                 const Handle& mv_h, bool es)
+{
+	AtomSpace *as = SchemeSmob::ss_get_env_as(fname);
+
+	// Fetch data trees
+	MinerDB mdb = get_db(db);
+
+	// Get minimum support, maximum conjuncts and maximum variables
+	unsigned ms = MinerUtils::get_uint(ms_h);
+	unsigned mc = MinerUtils::get_uint(mc_h);
+	unsigned mv = MinerUtils::get_uint(mv_h);
+
+	// Single conjunct patterns to expand conjunctions with
+	HandleSeq conjuncts;
+	for (const Handle& pattern : patterns->getOutgoingSet())
+		if (MinerUtils::n_conjuncts(pattern) == 1 and
+		    not MinerUtils::totally_abstract(pattern))
+			conjuncts.push_back(pattern);
+
+	HandleSeq selected;
+	for (const Handle& pattern : patterns->getOutgoingSet()) {
+		// The memoized support of pattern may only be calculated up
+		// to the minimum support, the exact one is needed to compare
+		// it with the ones of its specializations.
+		unsigned pms = maximal ? ms
+			: MinerUtils::support(pattern, mdb, UINT_MAX);
+		if (not MinerUtils::has_specialization(pattern, mdb, pms,
+		                                       conjuncts, mc, mv, es))
+			selected.push_back(pattern);
+	}
+	return as->add_link(SET_LINK, selected);
+}
+
 double MinerSCM::do_isurp_old(Handle pattern, Handle db)
 {
 	// Fetch data trees
-	HandleSeq db_seq = MinerUtils::get_db(db);
+	MinerDB mdb = get_db(db);
 
-	return Surprisingness::isurp_old(pattern, db_seq, false);
+	return Surprisingness::isurp_old(pattern, mdb, false);
 }
 
 double MinerSCM::do_nisurp_old(Handle pattern, Handle db)
 {
 	// Fetch data trees
-	HandleSeq db_seq = MinerUtils::get_db(db);
+	MinerDB mdb = get_db(db);
 
-	return Surprisingness::isurp_old(pattern, db_seq, true);
+	return Surprisingness::isurp_old(pattern, mdb, true);
 }
 
 double MinerSCM::do_isurp(Handle pattern, Handle db)
 {
 	// Fetch data trees
-	HandleSeq db_seq = MinerUtils::get_db(db);
+	MinerDB mdb = get_db(db);
 
-	return Surprisingness::isurp(pattern, db_seq, false);
+	return Surprisingness::isurp(pattern, mdb, false);
 }
 
 double MinerSCM::do_nisurp(Handle pattern, Handle db)
 {
 	// Fetch data trees
-	HandleSeq db_seq = MinerUtils::get_db(db);
+	MinerDB mdb = get_db(db);
 
-	return Surprisingness::isurp(pattern, db_seq, true);
+	return Surprisingness::isurp(pattern, mdb, true);
 }
 
 TruthValuePtr MinerSCM::do_emp_tv(Handle pattern, Handle db)
 {
 	// Fetch data trees
-	HandleSeq db_seq = MinerUtils::get_db(db);
+	MinerDB mdb = get_db(db);
 
 	// Calculate its estimate first to optimize empirical calculation
-	TruthValuePtr jte = Surprisingness::ji_tv_est_mem(pattern, db_seq);
-	return Surprisingness::emp_tv_pbs_mem(pattern, db_seq, jte->get_mean());
+	TruthValuePtr jte = Surprisingness::ji_tv_est_mem(pattern, mdb);
+	return Surprisingness::emp_tv_pbs_mem(pattern, mdb, jte->get_mean());
 }
 
 TruthValuePtr MinerSCM::do_ji_tv_est(Handle pattern, Handle db)
 {
 	// Fetch data trees
-	HandleSeq db_seq = MinerUtils::get_db(db);
+	MinerDB mdb = get_db(db);
 
-	return Surprisingness::ji_tv_est_mem(pattern, db_seq);
+	return Surprisingness::ji_tv_est_mem(pattern, mdb);
 }
 
 double MinerSCM::do_jsd(TruthValuePtr ltv, TruthValuePtr rtv)
@@ -323,6 +423,38 @@ double MinerSCM::do_jsd(TruthValuePtr ltv, TruthValuePtr rtv)
 	return Surprisingness::jsd(ltv, rtv);
 }
 
+MinerDB MinerSCM::get_db(const Handle& db_cpt)
+{
+	HandleSeq members = MinerUtils::get_db(db_cpt);
+
+	std::lock_guard<std::mutex> lock(_dbs_mtx);
+
+	// Move the db of db_cpt, if any, to the front, and discard stale
+	// ones.
+	auto it = _dbs.begin();
+	while (it != _dbs.end()) {
+		if (it->first == db_cpt) {
+			_dbs.splice(_dbs.begin(), _dbs, it++);
+			continue;
+		}
+		if (it->first->getAtomSpace() == nullptr)
+			it = _dbs.erase(it);
+		else
+			++it;
+	}
+
+	if (_dbs.empty() or _dbs.front().first != db_cpt)
+		_dbs.emplace_front(db_cpt, MinerDB(members));
+	else if (_dbs.front().second.handles() != members)
+		_dbs.front().second = MinerDB(members);
+
+	// Evict the least recently used dbs
+	while (max_dbs < _dbs.size())
+		_dbs.pop_back();
+
+	return _dbs.front().second;
+}
+
 extern "C" {
 void opencog_miner_init(void);
 };
@@ -22,9 +22,8 @@
  */
 
 #include "MinerUtils.h"
+#include "SupportCache.h"
 
-#include <opencog/util/dorepeat.h>
-#include <opencog/util/random.h>
 #include <opencog/util/algorithm.h>
 
 #include <opencog/atomspace/AtomSpace.h>
@@ -40,6 +39,7 @@
 #include <opencog/atoms/core/UnorderedLink.h>
 #include <opencog/atoms/pattern/PatternLink.h>
 #include <opencog/atoms/pattern/GetLink.h>
+#include <opencog/atoms/value/StringValue.h>
 #include <opencog/query/Satisfier.h>
 
 #include <boost/range/algorithm/transform.hpp>
@@ -48,6 +48,15 @@
 #include <boost/range/algorithm_ext/erase.hpp>
 #include <boost/numeric/conversion/cast.hpp>
 
+#include <algorithm>
+#include <climits>
+#include <iterator>
+#include <map>
+#include <set>
+#include <numeric>
+#include <string>
+#include <tuple>
+
 namespace opencog
 {
 
@@ -91,8 +100,17 @@ HandleSet MinerUtils::focus_shallow_abstract(const Valuations& valuations,
 	// Calculate how many valuations will be encompassed by these
 	// shallow abstractions
 	unsigned val_count = valuations.size() / var_scv.size();
-	for (const HandleSeq& valuation : var_scv.valuations) {
-		const Handle& value = var_scv.focus_value(valuation);
+
+	// Each distinct value is only abstracted once, weighted by its
+	// count. Link values are inspected through the flat encoding of
+	// the db, as their shallow abstractions only depend on their
+	// types and arities, thus are only built once per type and arity.
+	const MinerDB& db = var_scv.db;
+	const ValueIdSeq& var_col = var_scv.column(var_scv.focus_index());
+	std::map<std::tuple<Type, Arity, bool>, Handle> link_shabs;
+	for (const auto& idc : var_scv.histogram(var_scv.focus_index())) {
+		ValueId id = idc.first;
+		Arity arity = db.value_arity(id);
 
 		// If var_scv contains only one variable, then ignore shallow
 		// abstractions of nodes and nullary links as they create
@@ -107,12 +125,25 @@ HandleSet MinerUtils::focus_shallow_abstract(const Valuations& valuations,
 		//    reconnect, so they will remain useless.
 		//
 		// For these 2 reasons they can be safely ignored.
-		if (valuation.size() == 1 and is_nullary(value))
+		if (var_scv.columns.size() == 1 and arity == 0)
 			continue;
 
 		// Otherwise generate its shallow abstraction
-		if (Handle shabs = shallow_abstract_of_val(value))
-			shapats[shabs] += val_count;
+		Handle shabs;
+		if (arity == 0) {
+			shabs = shallow_abstract_of_val(db.value(id));
+		} else {
+			Type t = db.value_type(id);
+			bool grounded = t == EVALUATION_LINK and
+				db.value_type(db.value_child(id, 0)) == GROUNDED_PREDICATE_NODE;
+			auto key = std::make_tuple(t, arity, grounded);
+			auto it = link_shabs.find(key);
+			if (it == link_shabs.end())
+				it = link_shabs.insert({key, shallow_abstract_of_val(db.value(id))}).first;
+			shabs = it->second;
+		}
+		if (shabs)
+			shapats[shabs] += val_count * idc.second;
 	}
 
 	// Only consider shallow abstractions that reach the minimum
@@ -147,10 +178,10 @@ HandleSet MinerUtils::focus_shallow_abstract(const Valuations& valuations,
 		unsigned& rv_count = facvars[rv];
 
 		// If they are in different stronly connected valuations, then
-		// put all values of rv in a set, to quickly check if any
+		// use the counts of all values of rv, to quickly check if any
 		// value is in.
-		HandleUCounter rv_vals = same_scv ?
-			HandleUCounter() : rv_scv.values(rv_idx);
+		const ValueIdSeq& rv_col = rv_scv.column(rv_idx);
+		const ValueIdCounter& rv_vals = rv_scv.histogram(rv_idx);
 
 		// Calculate how many valuations will be encompassed by this
 		// variable factorization
@@ -158,14 +189,15 @@ HandleSet MinerUtils::focus_shallow_abstract(const Valuations& valuations,
 		if (not same_scv)
 			val_fac_count /= rv_scv.size();
 
-		for (const HandleSeq& valuation : var_scv.valuations) {
-			// Value associated to var
-			const Handle& val = valuation[var_scv.focus_index()];
+		for (unsigned row = 0; row < var_col.size(); row++) {
+			// Value associated to var. Values are interned in the db
+			// so equal values have equal identifiers.
+			ValueId val = var_col[row];
 
 			// If the value of var is equal to that of rv, then
 			// increase rv factorization count
 			if (same_scv) {
-				if (content_eq(val, valuation[rv_idx])) {
+				if (val == rv_col[row]) {
 					rv_count += val_fac_count;
 				}
 			}
@@ -206,8 +238,8 @@ Handle MinerUtils::shallow_abstract_of_val(const Handle& value)
 		return value;
 
 	Type tt = value->get_type();
-	HandleSeq rnd_vars = gen_rand_variables(value->get_arity());
-	Handle vardecl = variable_list(rnd_vars);
+	HandleSeq vars = gen_variables(value->get_arity());
+	Handle vardecl = variable_list(vars);
 
 	// TODO: this can probably be simplified using PresentLink, would
 	// entail to have RewriteLink::beta_reduce support PresentLink.
@@ -216,7 +248,7 @@ Handle MinerUtils::shallow_abstract_of_val(const Handle& value)
 	if (tt == AND_LINK or
 	    tt == OR_LINK or
 	    tt == NOT_LINK) {
-		return lambda(vardecl, local_quote(createLink(rnd_vars, tt)));
+		return lambda(vardecl, local_quote(createLink(vars, tt)));
 	}
 
 	if (tt == BIND_LINK or       // TODO: should probabably be replaced
@@ -231,7 +263,7 @@ Handle MinerUtils::shallow_abstract_of_val(const Handle& value)
 
 		// // Wrap variables in UnquoteLink
 		// HandleSeq uq_vars;
-		// for (Handle& var : rnd_vars)
+		// for (Handle& var : vars)
 		// 	uq_vars.push_back(unquote(var));
 
 		// return lambda(vardecl, quote(createLink(uq_vars, tt)));
@@ -249,7 +281,7 @@ Handle MinerUtils::shallow_abstract_of_val(const Handle& value)
 		return Handle::UNDEFINED;
 
 	// Generic non empty link, abstract away all the arguments
-	return lambda(vardecl, createLink(rnd_vars, tt));
+	return lambda(vardecl, createLink(vars, tt));
 }
 
 Handle MinerUtils::variable_list(const HandleSeq& vars)
@@ -279,9 +311,21 @@ Handle MinerUtils::local_quote(const Handle& h)
 
 Handle MinerUtils::compose(const Handle& pattern, const HandleMap& var2pat)
 {
-	if (RewriteLinkPtr sc = RewriteLinkCast(pattern))
-		return remove_useless_clauses(sc->beta_reduce(var2pat));
-	return pattern;
+	RewriteLinkPtr sc = RewriteLinkCast(pattern);
+	if (not sc)
+		return pattern;
+
+	// Since variable names are positional, sub-patterns likely share
+	// variables with pattern, or with each other, and must be alpha
+	// converted to avoid captures.
+	Variables used = sc->get_variables();
+	HandleMap avar2pat;
+	for (const auto& vp : var2pat) {
+		Handle apat = alpha_convert(vp.second, used);
+		used.extend(get_variables(apat));
+		avar2pat[vp.first] = apat;
+	}
+	return remove_useless_clauses(sc->beta_reduce(avar2pat));
 }
 
 Handle MinerUtils::vardecl_compose(const Handle& vardecl, const HandleMap& var2subdecl)
@@ -351,8 +395,10 @@ unsigned MinerUtils::get_uint(const Handle& h)
 }
 
 unsigned MinerUtils::support(const Handle& pattern,
-                             const HandleSeq& db,
-                             unsigned ms)
+                             const MinerDB& db,
+                             unsigned ms,
+                             const OccurrenceSet* occs,
+                             SupportCache* cache)
 {
 	// Partition the pattern into strongly connected components
 	HandleSeq cps(get_component_patterns(pattern));
@@ -361,34 +407,88 @@ unsigned MinerUtils::support(const Handle& pattern,
 	if (cps.empty())
 	    return 1;
 
-	// Otherwise calculate the frequency of each component
-	std::vector<unsigned> freqs;
-	boost::transform(cps, std::back_inserter(freqs),
-	                 [&](const Handle& cp)
-	                 { return component_support(cp, db, ms); });
+	// Process cheapest components first, that is totally abstract
+	// ones, which require no matching, then the most specific ones,
+	// which are likely to have fewer matches, and thus to lower the
+	// budget of the remaining components.
+	std::vector<std::pair<unsigned, Handle>> costed_cps;
+	for (const Handle& cp : cps)
+		costed_cps.push_back({totally_abstract(cp) ? 0 :
+		                      UINT_MAX - n_constants(cp), cp});
+	std::stable_sort(costed_cps.begin(), costed_cps.end(),
+	                 [](const std::pair<unsigned, Handle>& l,
+	                    const std::pair<unsigned, Handle>& r)
+	                 { return l.first < r.first; });
+
+	// Calculate the product of the frequencies of all components,
+	// each one being calculated up to the frequency needed for the
+	// product to reach ms, given the frequencies calculated so
+	// far. Once ms is reached the remaining components only need to
+	// be non-empty. If one is empty, no need to go further.
+	unsigned long long prod = 1;
+	for (const auto& ccp : costed_cps) {
+		unsigned cms = ms <= prod ? 1 : (ms + prod - 1) / prod;
+		unsigned freq = component_support(ccp.second, db, cms, occs, cache);
+		if (freq == 0)
+			return 0;
+		prod *= freq;
+	}
+	return (unsigned)std::min(prod, (unsigned long long)UINT_MAX);
+}
 
-	// Return the product of all frequencies
-	return boost::accumulate(freqs, 1, std::multiplies<unsigned>());
+unsigned MinerUtils::n_constants(const Handle& pattern)
+{
+	const Variables& vars = get_variables(pattern);
+	unsigned count = 0;
+	HandleSeq to_visit{get_body(pattern)};
+	while (not to_visit.empty()) {
+		Handle h = to_visit.back();
+		to_visit.pop_back();
+		if (vars.is_in_varset(h))
+			continue;
+		count++;
+		if (h->is_link())
+			for (const Handle& child : h->getOutgoingSet())
+				to_visit.push_back(child);
+	}
+	return count;
 }
 
 unsigned MinerUtils::component_support(const Handle& component,
-                                       const HandleSeq& db,
-                                       unsigned ms)
+                                       const MinerDB& db,
+                                       unsigned ms,
+                                       const OccurrenceSet* occs,
+                                       SupportCache* cache)
 {
 	if (totally_abstract(component))
 		return db.size();
-	return restricted_satisfying_set(component, db, ms)->get_arity();
+
+	// That component may have been evaluated as part of another
+	// pattern
+	std::string key;
+	unsigned freq;
+	if (cache) {
+		key = canonical_key(component);
+		if (cache->support(key, db, ms, freq))
+			return freq;
+	}
+
+	freq = restricted_satisfying_set(component, db, ms, occs)->get_arity();
+
+	if (cache)
+		cache->insert(key, db, freq, ms);
+	return freq;
 }
 
 bool MinerUtils::enough_support(const Handle& pattern,
-                                const HandleSeq& db,
+                                const MinerDB& db,
                                 unsigned ms)
 {
 	return ms <= support_mem(pattern, db, ms);
 }
 
 HandleSetSeq MinerUtils::shallow_abstract(const Handle& pattern,
-                                          const HandleSeq& db,
+                                          const MinerDB& db,
                                           unsigned ms)
 {
 	Valuations valuations(pattern, db);
@@ -396,7 +496,7 @@ HandleSetSeq MinerUtils::shallow_abstract(const Handle& pattern,
 }
 
 HandleSet MinerUtils::shallow_specialize(const Handle& pattern,
-                                         const HandleSeq& db,
+                                         const MinerDB& db,
                                          unsigned ms,
                                          unsigned mv)
 {
@@ -426,6 +526,28 @@ HandleSet MinerUtils::shallow_specialize(const Handle& pattern,
 	return results;
 }
 
+bool MinerUtils::has_specialization(const Handle& pattern,
+                                    const MinerDB& db,
+                                    unsigned ms,
+                                    const HandleSeq& conjuncts,
+                                    unsigned mc,
+                                    unsigned mv,
+                                    bool es)
+{
+	if (pattern->get_type() != LAMBDA_LINK)
+		return false;
+
+	if (not shallow_specialize(pattern, db, ms, mv).empty())
+		return true;
+
+	if (n_conjuncts(pattern) < mc and not totally_abstract(pattern))
+		for (const Handle& conjunct : conjuncts)
+			if (not expand_conjunction(pattern, conjunct, db, ms, mv, es).empty())
+				return true;
+
+	return false;
+}
+
 Handle MinerUtils::mk_body(const HandleSeq& clauses)
 {
 	if (clauses.size() == 0)
@@ -499,35 +621,308 @@ HandleSeq MinerUtils::get_conjuncts(const Handle& pattern)
 	return {};
 }
 
+Handle MinerUtils::restricted_satisfying_set(const Handle& pattern,
+                                             const MinerDB& db,
+                                             unsigned ms,
+                                             const OccurrenceSet* occs)
+{
+	// Tree patterns are directly matched over the atomspace of db,
+	// which is already indexed by incoming sets.
+	if (not tree_clause(pattern)) {
+		// Only accept groundings in the data trees it may occur in
+		OccurrenceSet cands;
+		bool narrowed = candidates(pattern, db, cands);
+		if (occs) {
+			cands = narrowed ? cands.intersect(*occs) : *occs;
+			narrowed = true;
+		}
+		if (narrowed and cands.empty())
+			return Handle(createUnorderedLink(HandleSeq(), SET_LINK));
+		if (narrowed and cands.size() < db.size())
+			return candidate_satisfying_set(pattern, db, cands, ms);
+	}
+
+	return restricted_satisfying_set(pattern, db.atomspace_handles(),
+	                                 db.atomspace(), ms);
+}
+
+/**
+ * Run pattern as a query over db_as, filling sater. The query is
+ * added to a child atomspace local to that call so that db_as is only
+ * read from.
+ */
+static void run_query(const Handle& pattern, AtomSpace& db_as,
+                      SatisfyingSet& sater)
+{
+	AtomSpace tmp_query_as(&db_as);
+	Handle tmp_pattern = tmp_query_as.add_atom(pattern),
+		vardecl = MinerUtils::get_vardecl(tmp_pattern),
+		body = MinerUtils::get_body(tmp_pattern),
+		gl = tmp_query_as.add_link(GET_LINK, vardecl, body);
+	GetLinkCast(gl)->satisfy(sater);
+}
+
 Handle MinerUtils::restricted_satisfying_set(const Handle& pattern,
                                              const HandleSeq& db,
+                                             AtomSpace& db_as,
                                              unsigned ms)
 {
-	static AtomSpace tmp_db_as; // TODO: fix to be thread safe
-	tmp_db_as.clear();
-	HandleSeq tmp_db;
-	for (const auto& dt : db)
-		tmp_db.push_back(tmp_db_as.add_atom(dt));
-
 	// Avoid pattern matcher warning
 	if (totally_abstract(pattern) and n_conjuncts(pattern) == 1)
-		return tmp_db_as.add_link(SET_LINK, tmp_db);
+		return Handle(createUnorderedLink(db, SET_LINK));
 
-	// Define pattern to run
-	AtomSpace tmp_query_as(&tmp_db_as);
-	Handle tmp_pattern = tmp_query_as.add_atom(pattern),
-		vardecl = get_vardecl(tmp_pattern),
-		body = get_body(tmp_pattern),
-		gl = tmp_query_as.add_link(GET_LINK, vardecl, body);
+	// Fast path for the most common patterns
+	Handle clause = tree_clause(pattern);
+	if (clause)
+		return tree_satisfying_set(pattern, clause, db_as, ms);
 
 	// Run pattern matcher
-	SatisfyingSet sater(&tmp_db_as);
+	SatisfyingSet sater(&db_as);
 	sater.max_results = ms;
-	GetLinkCast(gl)->satisfy(sater);
+	run_query(pattern, db_as, sater);
+
+	return Handle(createUnorderedLink(sater._satisfying_set, SET_LINK));
+}
+
+/**
+ * Satisfying set only accepting groundings of which each clause is
+ * grounded by an atom of some candidate data tree of db.
+ */
+class CandidateSatisfyingSet : public SatisfyingSet
+{
+public:
+	CandidateSatisfyingSet(const MinerDB& db, const OccurrenceSet& cands)
+		: SatisfyingSet(&db.atomspace()), _db(db), _cands(cands) {}
+
+	virtual bool clause_match(const Handle& ptrn,
+	                          const Handle& grnd,
+	                          const HandleMap& term_gnds)
+	{
+		if (not SatisfyingSet::clause_match(ptrn, grnd, term_gnds))
+			return false;
+
+		// Atoms of child atomspaces of the db atomspace, such as
+		// queries, have no identifier, thus are rejected as well.
+		ValueId id = _db.value_id(grnd);
+		if (id == MinerDB::npos)
+			return false;
+		for (unsigned i : _db.value_roots(id))
+			if (_cands.contains(i))
+				return true;
+		return false;
+	}
+
+private:
+	const MinerDB& _db;
+	const OccurrenceSet& _cands;
+};
+
+Handle MinerUtils::candidate_satisfying_set(const Handle& pattern,
+                                            const MinerDB& db,
+                                            const OccurrenceSet& cands,
+                                            unsigned ms)
+{
+	// Avoid pattern matcher warning, the candidates are the
+	// groundings then.
+	if (totally_abstract(pattern) and n_conjuncts(pattern) == 1) {
+		HandleSeq cdb;
+		for (unsigned i : cands.indices())
+			cdb.push_back(db.atomspace_handles()[i]);
+		return Handle(createUnorderedLink(cdb, SET_LINK));
+	}
+
+	CandidateSatisfyingSet sater(db, cands);
+	sater.max_results = ms;
+	run_query(pattern, db.atomspace(), sater);
 
 	return Handle(createUnorderedLink(sater._satisfying_set, SET_LINK));
 }
 
+bool MinerUtils::candidates(const Handle& pattern,
+                            const MinerDB& db,
+                            OccurrenceSet& cands)
+{
+	if (pattern->get_type() != LAMBDA_LINK)
+		return false;
+
+	HandleSeq clauses = get_clauses(pattern);
+	if (clauses.empty())
+		return false;
+
+	// Union of the candidates of each clause
+	cands = OccurrenceSet(db.size());
+	for (const Handle& clause : clauses) {
+		// Locally quoted links are matched as is
+		bool quoted = clause->get_type() == LOCAL_QUOTE_LINK;
+		const Handle& link = quoted ? clause->getOutgoingAtom(0) : clause;
+		if (not (quoted ? link->is_link() : is_literal_clause(link)))
+			return false;
+
+		// Data trees containing links of that type and arity
+		Type t = link->get_type();
+		const HandleSeq& args = link->getOutgoingSet();
+		OccurrenceSet ccands(db.link_roots(t, args.size()), db.size());
+
+		// Intersected with the data trees containing links of that
+		// type with the same constant arguments at the same positions.
+		// Arguments with variables or quotations are ignored.
+		if (not nameserver().isA(t, UNORDERED_LINK)) {
+			for (Arity pos = 0; pos < args.size() and not ccands.empty(); pos++) {
+				if (contains_atomtype(args[pos], VARIABLE_NODE) or
+				    contains_atomtype(args[pos], QUOTE_LINK) or
+				    contains_atomtype(args[pos], UNQUOTE_LINK) or
+				    contains_atomtype(args[pos], LOCAL_QUOTE_LINK))
+					continue;
+				Handle arg = db.atomspace().get_atom(args[pos]);
+				ValueId id = arg ? db.value_id(arg) : MinerDB::npos;
+				if (id == MinerDB::npos) {
+					ccands = OccurrenceSet(db.size());
+					break;
+				}
+				OccurrenceSet pos_cands(db.link_roots(t, pos, id), db.size());
+				ccands = ccands.intersect(pos_cands);
+			}
+		}
+
+		cands = cands.unite(ccands);
+	}
+	return true;
+}
+
+bool MinerUtils::is_literal_clause(const Handle& clause)
+{
+	Type ct = clause->get_type();
+	if (not clause->is_link() or
+	    ct == QUOTE_LINK or ct == UNQUOTE_LINK or ct == LOCAL_QUOTE_LINK or
+	    nameserver().isA(ct, SCOPE_LINK) or
+	    nameserver().isA(ct, FUNCTION_LINK) or
+	    nameserver().isA(ct, VIRTUAL_LINK))
+		return false;
+	if (nameserver().isA(ct, EVALUATABLE_LINK) and
+	    (ct != EVALUATION_LINK or clause->get_arity() == 0 or
+	     clause->getOutgoingAtom(0)->get_type() != PREDICATE_NODE))
+		return false;
+	return true;
+}
+
+Handle MinerUtils::tree_clause(const Handle& pattern)
+{
+	if (pattern->get_type() != LAMBDA_LINK)
+		return Handle::UNDEFINED;
+
+	// Variables must be present and untyped
+	const Variables& vars = get_variables(pattern);
+	if (vars.varseq.empty() or
+	    not vars._simple_typemap.empty() or not vars._deep_typemap.empty())
+		return Handle::UNDEFINED;
+
+	// Single clause
+	HandleSeq clauses = get_clauses(pattern);
+	if (clauses.size() != 1)
+		return Handle::UNDEFINED;
+	const Handle& clause = clauses.front();
+
+	// Of an ordered link type matched as is by the pattern matcher
+	if (not is_literal_clause(clause) or
+	    nameserver().isA(clause->get_type(), UNORDERED_LINK))
+		return Handle::UNDEFINED;
+
+	// Whose arguments are variables or ground constants, and which
+	// contains all variables, so that distinct groundings are
+	// distinct atoms.
+	HandleSet clause_vars;
+	for (const Handle& arg : clause->getOutgoingSet()) {
+		if (vars.is_in_varset(arg))
+			clause_vars.insert(arg);
+		else if (contains_atomtype(arg, VARIABLE_NODE) or
+		         contains_atomtype(arg, QUOTE_LINK) or
+		         contains_atomtype(arg, UNQUOTE_LINK) or
+		         contains_atomtype(arg, LOCAL_QUOTE_LINK))
+			return Handle::UNDEFINED;
+	}
+	if (clause_vars.size() != vars.varseq.size())
+		return Handle::UNDEFINED;
+
+	return clause;
+}
+
+Handle MinerUtils::tree_satisfying_set(const Handle& pattern,
+                                       const Handle& clause,
+                                       const AtomSpace& db_as,
+                                       unsigned ms)
+{
+	const Variables& vars = get_variables(pattern);
+	const HandleSeq& args = clause->getOutgoingSet();
+	Type ct = clause->get_type();
+	Arity arity = args.size();
+
+	// Map each argument to the index of its variable, or to its atom
+	// in db_as if constant, and pick the rarest constant. If some
+	// constant is not in db_as, there is no match.
+	static const unsigned constant = UINT_MAX;
+	std::vector<unsigned> arg_var_idxs(arity, constant);
+	HandleSeq db_args(arity);
+	Handle rarest;
+	for (Arity i = 0; i < arity; i++) {
+		auto it = vars.index.find(args[i]);
+		if (it != vars.index.end()) {
+			arg_var_idxs[i] = it->second;
+			continue;
+		}
+		db_args[i] = db_as.get_atom(args[i]);
+		if (not db_args[i])
+			return Handle(createUnorderedLink(HandleSeq(), SET_LINK));
+		if (not rarest or
+		    db_args[i]->getIncomingSetSize() < rarest->getIncomingSetSize())
+			rarest = db_args[i];
+	}
+
+	// Candidates. Atoms of child atomspaces of db_as, such as queries
+	// being run concurrently, may be in incoming sets, they are
+	// filtered out below.
+	HandleSeq candidates;
+	if (rarest) {
+		for (const LinkPtr& l : rarest->getIncomingSetByType(ct))
+			candidates.push_back(l->get_handle());
+	} else {
+		db_as.get_handles_by_type(std::inserter(candidates, candidates.end()),
+		                          ct);
+	}
+
+	// Compare candidates to the clause, argument by argument
+	HandleSeq satset;
+	HandleSeq grounding(vars.varseq.size());
+	for (const Handle& cand : candidates) {
+		if (ms <= satset.size())
+			break;
+		if (cand->getAtomSpace() != &db_as or cand->get_arity() != arity)
+			continue;
+		const HandleSeq& cand_args = cand->getOutgoingSet();
+		std::fill(grounding.begin(), grounding.end(), Handle::UNDEFINED);
+		bool match = true;
+		for (Arity i = 0; match and i < arity; i++) {
+			if (arg_var_idxs[i] == constant) {
+				match = cand_args[i] == db_args[i];
+				continue;
+			}
+			Handle& value = grounding[arg_var_idxs[i]];
+			if (value)
+				match = value == cand_args[i];
+			else
+				value = cand_args[i];
+		}
+		if (not match)
+			continue;
+
+		// Like the pattern matcher, a single variable is grounded by
+		// its value, several by the list of their values.
+		satset.push_back(grounding.size() == 1 ? grounding.front()
+		                 : Handle(createLink(grounding, LIST_LINK)));
+	}
+
+	return Handle(createUnorderedLink(satset, SET_LINK));
+}
+
 bool MinerUtils::totally_abstract(const Handle& pattern)
 {
 	// Check whether it is an abstraction to begin with
@@ -553,17 +948,26 @@ bool MinerUtils::totally_abstract(const Handle& pattern)
 	return true;
 }
 
-HandleSeq MinerUtils::gen_rand_variables(size_t n)
+Handle MinerUtils::gen_variable(unsigned i)
+{
+	return createNode(VARIABLE_NODE, "$PM-" + std::to_string(i));
+}
+
+HandleSeq MinerUtils::gen_variables(size_t n)
 {
 	HandleSeq variables;
-	dorepeat (n)
-		variables.push_back(gen_rand_variable());
+	for (unsigned i = 0; i < n; i++)
+		variables.push_back(gen_variable(i));
 	return variables;
 }
 
-Handle MinerUtils::gen_rand_variable()
+Handle MinerUtils::gen_fresh_variable(const std::set<std::string>& used)
 {
-	return createNode(VARIABLE_NODE, randstr("$PM-"));
+	for (unsigned i = 0;; i++) {
+		Handle var = gen_variable(i);
+		if (used.find(var->get_name()) == used.end())
+			return var;
+	}
 }
 
 const Variables& MinerUtils::get_variables(const Handle& pattern)
@@ -683,17 +1087,19 @@ Handle MinerUtils::alpha_convert(const Handle& pattern,
 {
 	const Variables& pattern_vars = get_variables(pattern);
 
-	// Detect collision between pattern_vars and other_vars
+	// Detect collision between pattern_vars and other_vars, and
+	// replace colliding variables by the lowest positional variables
+	// not in other_vars or pattern_vars.
+	std::set<std::string> used;
+	for (const Handle& var : other_vars.varseq)
+		used.insert(var->get_name());
+	for (const Handle& var : pattern_vars.varseq)
+		used.insert(var->get_name());
 	HandleMap aconv;
-	for (const Handle& var : pattern_vars.varset) {
+	for (const Handle& var : pattern_vars.varseq) {
 		if (other_vars.is_in_varset(var)) {
-			Handle nvar;
-			bool used;
-			do {
-				nvar = createNode(VARIABLE_NODE, randstr(var->get_name() + "-"));
-				// Make sure it is not in other_vars or pattern_vars
-				used = other_vars.is_in_varset(nvar) or pattern_vars.is_in_varset(nvar);
-			} while (used);
+			Handle nvar = gen_fresh_variable(used);
+			used.insert(nvar->get_name());
 			aconv[var] = nvar;
 		}
 	}
@@ -782,7 +1188,7 @@ Handle MinerUtils::expand_conjunction_connect(const Handle& cnjtion,
 
 HandleSet MinerUtils::expand_conjunction_rec(const Handle& cnjtion,
                                              const Handle& pattern,
-                                             const HandleSeq& db,
+                                             const MinerDB& db,
                                              unsigned ms,
                                              unsigned mv,
                                              const HandleMap& pv2cv,
@@ -826,7 +1232,7 @@ HandleSet MinerUtils::expand_conjunction_rec(const Handle& cnjtion,
 
 HandleSet MinerUtils::expand_conjunction_es_rec(const Handle& cnjtion,
                                                 const Handle& pattern,
-                                                const HandleSeq& db,
+                                                const MinerDB& db,
                                                 unsigned ms,
                                                 unsigned mv,
                                                 const HandleMap& pv2cv,
@@ -880,7 +1286,7 @@ HandleSet MinerUtils::expand_conjunction_es_rec(const Handle& cnjtion,
 
 HandleSet MinerUtils::expand_conjunction(const Handle& cnjtion,
                                          const Handle& pattern,
-                                         const HandleSeq& db,
+                                         const MinerDB& db,
                                          unsigned ms,
                                          unsigned mv,
                                          bool es)
@@ -916,15 +1322,381 @@ double MinerUtils::get_support(const Handle& pattern)
 }
 
 double MinerUtils::support_mem(const Handle& pattern,
-                               const HandleSeq& db,
-                               unsigned ms)
+                               const MinerDB& db,
+                               unsigned ms,
+                               const OccurrenceSet* occs,
+                               SupportCache* cache)
 {
 	double sup = get_support(pattern);
 	if (sup < 0) {
-		sup = support(pattern, db, ms);
+		sup = support(pattern, db, ms, occs, cache);
 		set_support(pattern, sup);
 	}
 	return sup;
 }
 
+static void serialize(const Handle& h, const Variables& vars,
+                      std::map<Handle, unsigned>* var_idx,
+                      std::string& out);
+
+/**
+ * Serialize the type restrictions of var declared in vars, if any,
+ * into out, so that patterns only differing by them have different
+ * keys.
+ */
+static void serialize_types(const Handle& var, const Variables& vars,
+                            std::string& out)
+{
+	std::set<std::string> sigs;
+	auto sit = vars._simple_typemap.find(var);
+	if (sit != vars._simple_typemap.end())
+		for (Type t : sit->second)
+			sigs.insert(nameserver().getTypeName(t));
+	auto dit = vars._deep_typemap.find(var);
+	if (dit != vars._deep_typemap.end()) {
+		for (const Handle& sig : dit->second) {
+			std::string ssig;
+			serialize(sig, Variables(), nullptr, ssig);
+			sigs.insert(ssig);
+		}
+	}
+	if (sigs.empty())
+		return;
+	out += ":{";
+	for (const std::string& sig : sigs)
+		out += sig + ",";
+	out.back() = '}';
+}
+
+/**
+ * Serialize h into out. Variables of vars are numbered in order of
+ * first encounter in var_idx, or replaced by a placeholder if
+ * var_idx is null, followed by their type restrictions. Outgoings of
+ * unordered links are sorted according to their serializations with
+ * placeholders.
+ */
+static void serialize(const Handle& h, const Variables& vars,
+                      std::map<Handle, unsigned>* var_idx,
+                      std::string& out)
+{
+	if (vars.is_in_varset(h)) {
+		out += "$";
+		if (var_idx) {
+			unsigned idx =
+				var_idx->insert({h, (unsigned)var_idx->size()}).first->second;
+			out += std::to_string(idx);
+		}
+		serialize_types(h, vars, out);
+		return;
+	}
+
+	Type t = h->get_type();
+	out += "(" + nameserver().getTypeName(t);
+	if (h->is_node()) {
+		out += " \"" + h->get_name() + "\")";
+		return;
+	}
+
+	HandleSeq outs = h->getOutgoingSet();
+	if (nameserver().isA(t, UNORDERED_LINK)) {
+		std::vector<std::pair<std::string, Handle>> sig_outs;
+		for (const Handle& child : outs) {
+			std::string sig;
+			serialize(child, vars, nullptr, sig);
+			sig_outs.push_back({sig, child});
+		}
+		std::stable_sort(sig_outs.begin(), sig_outs.end(),
+		                 [](const std::pair<std::string, Handle>& l,
+		                    const std::pair<std::string, Handle>& r)
+		                 { return l.first < r.first; });
+		for (unsigned i = 0; i < outs.size(); i++)
+			outs[i] = sig_outs[i].second;
+	}
+	for (const Handle& child : outs) {
+		out += " ";
+		serialize(child, vars, var_idx, out);
+	}
+	out += ")";
+}
+
+/**
+ * Move to the next permutation of order, only permuting within the
+ * given ranges, like an odometer. Return false when all permutations
+ * have been enumerated.
+ */
+static bool next_tie_permutation(std::vector<unsigned>& order,
+                                 const std::vector<std::pair<unsigned, unsigned>>& ties)
+{
+	for (auto it = ties.rbegin(); it != ties.rend(); ++it)
+		// If that range has no next permutation, next_permutation
+		// resets it, then move to the previous range.
+		if (std::next_permutation(order.begin() + it->first,
+		                          order.begin() + it->second))
+			return true;
+	return false;
+}
+
+/**
+ * Return the canonical key of pattern (see MinerUtils::canonical_key),
+ * and if provided, fill clauses and vars with the clauses and
+ * variables of pattern in canonical order.
+ */
+static std::string canonical_labeling(const Handle& pattern,
+                                      HandleSeq* cclauses=nullptr,
+                                      HandleSeq* cvars=nullptr)
+{
+	// Constant pattern
+	if (pattern->get_type() != LAMBDA_LINK) {
+		std::string key;
+		serialize(pattern, Variables(), nullptr, key);
+		return key;
+	}
+
+	const Variables& vars = MinerUtils::get_variables(pattern);
+	const Handle& body = MinerUtils::get_body(pattern);
+	HandleSeq clauses = MinerUtils::get_clauses_of_body(body);
+
+	// Sort clauses according to their serializations with
+	// placeholders, which do not depend on variable names.
+	std::vector<std::pair<std::string, Handle>> sig_clauses;
+	for (const Handle& clause : clauses) {
+		std::string sig;
+		serialize(clause, vars, nullptr, sig);
+		sig_clauses.push_back({sig, clause});
+	}
+	std::stable_sort(sig_clauses.begin(), sig_clauses.end(),
+	                 [](const std::pair<std::string, Handle>& l,
+	                    const std::pair<std::string, Handle>& r)
+	                 { return l.first < r.first; });
+
+	// Find the ranges of clauses with the same serialization, which
+	// are to be permuted, if there are not too many permutations.
+	std::vector<std::pair<unsigned, unsigned>> ties;
+	unsigned n_perms = 1;
+	for (unsigned i = 0; i < sig_clauses.size();) {
+		unsigned j = i + 1;
+		while (j < sig_clauses.size() and
+		       sig_clauses[j].first == sig_clauses[i].first)
+			j++;
+		if (1 < j - i) {
+			ties.push_back({i, j});
+			for (unsigned k = 2; k <= j - i and
+				     n_perms <= MinerUtils::max_canonical_permutations; k++)
+				n_perms *= k;
+		}
+		i = j;
+	}
+	if (MinerUtils::max_canonical_permutations < n_perms)
+		ties.clear();
+
+	// Number the variables in order of appearance for each
+	// permutation of tied clauses, and keep the lowest key.
+	std::string prefix = body->get_type() == AND_LINK or
+		body->get_type() == PRESENT_LINK ?
+		nameserver().getTypeName(body->get_type()) : "";
+	std::vector<unsigned> order(sig_clauses.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::string best;
+	std::vector<unsigned> best_order;
+	std::map<Handle, unsigned> best_var_idx;
+	bool first = true;
+	do {
+		std::map<Handle, unsigned> var_idx;
+		std::string key = prefix;
+		for (unsigned i : order) {
+			key += " ";
+			serialize(sig_clauses[i].second, vars, &var_idx, key);
+		}
+		if (first or key < best) {
+			best = key;
+			best_order = order;
+			best_var_idx = var_idx;
+			first = false;
+		}
+	} while (next_tie_permutation(order, ties));
+
+	if (cclauses) {
+		cclauses->clear();
+		for (unsigned i : best_order)
+			cclauses->push_back(sig_clauses[i].second);
+	}
+	if (cvars) {
+		// Variables not appearing in the body go last
+		*cvars = HandleSeq(best_var_idx.size());
+		for (const auto& vi : best_var_idx)
+			(*cvars)[vi.second] = vi.first;
+		for (const Handle& var : vars.varseq)
+			if (best_var_idx.find(var) == best_var_idx.end())
+				cvars->push_back(var);
+	}
+	return best;
+}
+
+const Handle& MinerUtils::canonical_key_key()
+{
+	static Handle ck(createNode(NODE, "*-CanonicalKeyValueKey-*"));
+	return ck;
+}
+
+std::string MinerUtils::canonical_key(const Handle& pattern)
+{
+	StringValuePtr key_sv =
+		StringValueCast(pattern->getValue(canonical_key_key()));
+	if (key_sv)
+		return key_sv->value().front();
+
+	std::string key = canonical_labeling(pattern);
+	pattern->setValue(canonical_key_key(), createStringValue(key));
+	return key;
+}
+
+Handle MinerUtils::canonical_pattern(const Handle& pattern,
+                                     HandleMap* renaming)
+{
+	if (pattern->get_type() != LAMBDA_LINK)
+		return pattern;
+
+	HandleSeq clauses, vars;
+	canonical_labeling(pattern, &clauses, &vars);
+
+	// Rename variables by their positions in canonical order
+	HandleMap var2cvar;
+	HandleSeq cvars = gen_variables(vars.size());
+	for (unsigned i = 0; i < vars.size(); i++)
+		var2cvar[vars[i]] = cvars[i];
+	const Variables& pattern_vars = get_variables(pattern);
+
+	// Keep their type restrictions, if any
+	Handle vardecl = get_vardecl(pattern);
+	HandleSeq decls = vardecl->get_type() == VARIABLE_LIST ?
+		vardecl->getOutgoingSet() : HandleSeq{vardecl};
+	HandleMap var2decl;
+	for (const Handle& decl : decls)
+		if (decl->get_type() == TYPED_VARIABLE_LINK)
+			var2decl[decl->getOutgoingAtom(0)] = decl;
+	HandleSeq cdecls(cvars);
+	for (unsigned i = 0; i < vars.size(); i++) {
+		auto it = var2decl.find(vars[i]);
+		if (it != var2decl.end())
+			cdecls[i] = pattern_vars.substitute_nocheck(it->second, var2cvar);
+	}
+
+	HandleSeq cclauses;
+	for (const Handle& clause : clauses)
+		cclauses.push_back(pattern_vars.substitute_nocheck(clause, var2cvar));
+
+	const Handle& body = get_body(pattern);
+	Type bt = body->get_type();
+	Handle cbody;
+	if (bt == PRESENT_LINK)
+		cbody = Handle(createPresentLink(cclauses));
+	else if (bt == AND_LINK)
+		cbody = Handle(createLink(cclauses, AND_LINK));
+	else
+		cbody = pattern_vars.substitute_nocheck(body, var2cvar);
+
+	if (renaming)
+		*renaming = var2cvar;
+	return lambda(variable_list(cdecls), cbody);
+}
+
+std::uint64_t MinerUtils::canonical_hash(const std::string& key)
+{
+	// 64-bit FNV-1a
+	std::uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char c : key) {
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+std::uint64_t MinerUtils::pattern_hash(const Handle& pattern)
+{
+	return canonical_hash(canonical_key(pattern));
+}
+
+/**
+ * Replace all occurrences of from by to in h.
+ */
+static Handle replace(const Handle& h, const Handle& from, const Handle& to)
+{
+	if (content_eq(h, from))
+		return to;
+	if (h->is_node())
+		return h;
+	HandleSeq outs;
+	for (const Handle& child : h->getOutgoingSet())
+		outs.push_back(replace(child, from, to));
+	return createLink(outs, h->get_type());
+}
+
+HandleSeq MinerUtils::generalizations(const Handle& pattern)
+{
+	if (pattern->get_type() != LAMBDA_LINK)
+		return {};
+
+	const Variables& vars = get_variables(pattern);
+	HandleSeq clauses = get_clauses(pattern);
+
+	// Count the occurrences of each variable, and collect all
+	// non-variable subterms.
+	std::map<Handle, unsigned> var_count;
+	HandleSet subterms;
+	HandleSeq to_visit(clauses);
+	while (not to_visit.empty()) {
+		Handle h = to_visit.back();
+		to_visit.pop_back();
+		if (vars.is_in_varset(h)) {
+			var_count[h]++;
+			continue;
+		}
+		subterms.insert(h);
+		if (h->is_link())
+			for (const Handle& child : h->getOutgoingSet())
+				to_visit.push_back(child);
+	}
+
+	// A subterm can be abstracted if it is a constant node, or a link
+	// with only variables, appearing nowhere else, as outgoings.
+	auto abstractable = [&](const Handle& h) {
+		if (h->is_node())
+			return true;
+		HandleSet outs;
+		for (const Handle& child : h->getOutgoingSet())
+			if (not vars.is_in_varset(child) or var_count[child] != 1 or
+			    not outs.insert(child).second)
+				return false;
+		return true;
+	};
+
+	std::set<std::string> var_names;
+	for (const Handle& var : vars.varseq)
+		var_names.insert(var->get_name());
+
+	HandleSeq gens;
+	for (const Handle& subterm : subterms) {
+		if (not abstractable(subterm))
+			continue;
+		Handle var = gen_fresh_variable(var_names);
+		HandleSeq nclauses;
+		for (const Handle& clause : clauses)
+			nclauses.push_back(replace(clause, subterm, var));
+		HandleSeq nvars(vars.varseq);
+		nvars.push_back(var);
+		Handle gen = mk_pattern_filtering_vardecl(variable_list(nvars),
+		                                          nclauses);
+		if (not gen)
+			continue;
+
+		// The support of a totally abstract component is the db size
+		// rather than its number of subtrees, which breaks
+		// anti-monotonicity, so such generalizations are ignored.
+		HandleSeq gcps = get_component_patterns(gen);
+		if (std::none_of(gcps.begin(), gcps.end(), totally_abstract))
+			gens.push_back(gen);
+	}
+	return gens;
+}
+
 } // namespace opencog
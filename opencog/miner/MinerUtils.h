@@ -23,13 +23,24 @@
 #ifndef OPENCOG_MINER_UTILS_H_
 #define OPENCOG_MINER_UTILS_H_
 
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_set>
+
 #include <opencog/atoms/base/Handle.h>
 
+#include "MinerDB.h"
+#include "OccurrenceSet.h"
 #include "Valuations.h"
 
 namespace opencog
 {
 
+class SupportCache;
+
+class AtomSpace;
+
 /**
  * Collection of static methods for the pattern miner.
  */
@@ -165,7 +176,8 @@ public:
 	 * compose (as in function composition) the pattern with the
 	 * sub-patterns. That is replace variables in the pattern by their
 	 * associated sub-patterns, properly updating the variable
-	 * declaration.
+	 * declaration. Sub-patterns are alpha converted beforehand so
+	 * that their variables do not collide with the ones of pattern.
 	 */
 	static Handle compose(const Handle& pattern, const HandleMap& var2pat);
 
@@ -198,19 +210,48 @@ public:
 
 	/**
 	 * Given a pattern and a db, calculate the pattern frequency up to
-	 * ms (to avoid unnecessary calculations).
+	 * ms (to avoid unnecessary calculations). That is the frequency is
+	 * exact if below ms, otherwise it is only guarantied to be equal
+	 * to or above ms.
+	 *
+	 * The frequency of a pattern is the product of the frequencies
+	 * of its strongly connected components. These are calculated
+	 * from the cheapest to the most expensive, each up to ms divided
+	 * by the product of the frequencies calculated so far, and the
+	 * calculation stops as soon as a component has no match.
+	 *
+	 * If provided, occs is a superset of the data trees containing
+	 * the groundings of pattern, typically the occurrences of its
+	 * parent (see Valuations::occurrences), and cache holds component
+	 * supports calculated so far, see component_support.
 	 */
 	static unsigned support(const Handle& pattern,
-	                        const HandleSeq& db,
-	                        unsigned ms);
+	                        const MinerDB& db,
+	                        unsigned ms,
+	                        const OccurrenceSet* occs=nullptr,
+	                        SupportCache* cache=nullptr);
+
+	/**
+	 * Return the number of atoms of the body of pattern that are not
+	 * variables (including the body itself, if not a variable).
+	 */
+	static unsigned n_constants(const Handle& pattern);
 
 	/**
 	 * Like support but assumes that pattern is strongly connected (all
 	 * its variables depends on other clauses).
+	 *
+	 * The data trees it is matched against are narrowed down by occs,
+	 * if provided, see restricted_satisfying_set. If cache is
+	 * provided, the support of pattern is looked up there first, as
+	 * components are shared by many patterns, then stored in it once
+	 * calculated.
 	 */
 	static unsigned component_support(const Handle& pattern,
-	                                  const HandleSeq& db,
-	                                  unsigned ms);
+	                                  const MinerDB& db,
+	                                  unsigned ms,
+	                                  const OccurrenceSet* occs=nullptr,
+	                                  SupportCache* cache=nullptr);
 
 	/**
 	 * Calculate if the pattern has enough support w.r.t. to the given
@@ -218,7 +259,7 @@ public:
 	 * to ms.
 	 */
 	static bool enough_support(const Handle& pattern,
-	                           const HandleSeq& db,
+	                           const MinerDB& db,
 	                           unsigned ms);
 
 	/**
@@ -230,7 +271,7 @@ public:
 	 * details.
 	 */
 	static HandleSetSeq shallow_abstract(const Handle& pattern,
-	                                     const HandleSeq& db,
+	                                     const MinerDB& db,
 	                                     unsigned ms);
 
 	/**
@@ -241,10 +282,31 @@ public:
 	 * patterns.
 	 */
 	static HandleSet shallow_specialize(const Handle& pattern,
-	                                    const HandleSeq& db,
+	                                    const MinerDB& db,
 	                                    unsigned ms,
 	                                    unsigned mv=UINT_MAX);
 
+	/**
+	 * Return true iff pattern has a specialization with support ms
+	 * or above according to db, either a shallow specialization, or,
+	 * if pattern has fewer than mc conjuncts, an expansion of its
+	 * conjunction with one of conjuncts (see expand_conjunction).
+	 *
+	 * mv and es are passed to shallow_specialize and
+	 * expand_conjunction.
+	 *
+	 * With ms the support of pattern, it tells whether pattern is not
+	 * closed, and with ms the minimum support whether it is not
+	 * maximal.
+	 */
+	static bool has_specialization(const Handle& pattern,
+	                               const MinerDB& db,
+	                               unsigned ms,
+	                               const HandleSeq& conjuncts=HandleSeq(),
+	                               unsigned mc=1,
+	                               unsigned mv=UINT_MAX,
+	                               bool es=true);
+
 	/**
 	 * Create a pattern body from clauses, introducing an AndLink if
 	 * necessary.
@@ -317,11 +379,109 @@ public:
 	 *
 	 * Also, the pattern may match any subhypergraph of db, not just
 	 * the root atoms (TODO: we probably don't want that!!!).
+	 *
+	 * The query runs over the atomspace of db, built once and shared
+	 * by all calls, so this is thread safe.
+	 *
+	 * Unless pattern is a tree pattern (see tree_clause), the data
+	 * trees it may match are first narrowed down by the link index of
+	 * db (see candidates), and by occs if provided, as the data trees
+	 * containing the groundings of pattern. If some data trees are
+	 * left out, then the query only accepts groundings within the
+	 * remaining ones (see candidate_satisfying_set).
+	 */
+	static Handle restricted_satisfying_set(const Handle& pattern,
+	                                        const MinerDB& db,
+	                                        unsigned ms=UINT_MAX,
+	                                        const OccurrenceSet* occs=nullptr);
+
+	/**
+	 * Like above but db is assumed to be already in db_as, which is
+	 * only read from. The query itself is built in a temporary child
+	 * atomspace, so it is reentrant as long as db_as is not modified
+	 * concurrently.
 	 */
 	static Handle restricted_satisfying_set(const Handle& pattern,
 	                                        const HandleSeq& db,
+	                                        AtomSpace& db_as,
 	                                        unsigned ms=UINT_MAX);
 
+	/**
+	 * Like restricted_satisfying_set over the atomspace of db, but
+	 * only accept groundings of which each clause is grounded by an
+	 * atom of some data tree of cands. Since the query runs over the
+	 * atomspace of db as is, nothing is copied.
+	 */
+	static Handle candidate_satisfying_set(const Handle& pattern,
+	                                       const MinerDB& db,
+	                                       const OccurrenceSet& cands,
+	                                       unsigned ms=UINT_MAX);
+
+	/**
+	 * Fill cands with the data trees of db that may contain the
+	 * groundings of pattern, according to the link index of db (see
+	 * MinerDB::link_roots). That is, for each clause, the data trees
+	 * containing links of its type and arity, with its constant
+	 * arguments at the same positions, if ordered. For instance the
+	 * candidates of
+	 *
+	 * (Lambda
+	 *   (Variable "$X")
+	 *   (Present
+	 *     (Inheritance (Variable "$X") (Concept "male"))))
+	 *
+	 * are the intersection of the data trees containing binary
+	 * inheritance links, and the data trees containing inheritance
+	 * links with (Concept "male") as second argument.
+	 *
+	 * Return false if some clause cannot be indexed, such as a
+	 * variable or a virtual clause, in which case any data tree is a
+	 * candidate.
+	 */
+	static bool candidates(const Handle& pattern,
+	                       const MinerDB& db,
+	                       OccurrenceSet& cands);
+
+	/**
+	 * Return true iff clause is a link that the pattern matcher
+	 * matches as is, that is not quoted, scoped, function, virtual or
+	 * evaluatable, predicate evaluations aside.
+	 */
+	static bool is_literal_clause(const Handle& clause);
+
+	/**
+	 * Return the clause of pattern if it is a tree pattern, that is
+	 * made of a single clause of one link type, the arguments of
+	 * which are either variables or constants, such as
+	 *
+	 * (Lambda
+	 *   (VariableList (Variable "$X") (Variable "$Y"))
+	 *   (Present
+	 *     (Inheritance (Variable "$X") (Variable "$Y"))))
+	 *
+	 * as produced by shallow_abstract_of_val and its compositions with
+	 * constants. Variables must be untyped, and the link must not be
+	 * quoted, unordered, scoped or virtual, otherwise
+	 * Handle::UNDEFINED is returned.
+	 *
+	 * Such patterns can be matched by tree_satisfying_set, without the
+	 * pattern matcher.
+	 */
+	static Handle tree_clause(const Handle& pattern);
+
+	/**
+	 * Like restricted_satisfying_set, but assumes pattern is a tree
+	 * pattern (see tree_clause), and matches its clause by directly
+	 * comparing type, arity and constant arguments with the atoms of
+	 * db_as. Candidates are taken from the incoming set of the
+	 * rarest constant argument, if any, or from the atoms of that
+	 * type otherwise.
+	 */
+	static Handle tree_satisfying_set(const Handle& pattern,
+	                                  const Handle& clause,
+	                                  const AtomSpace& db_as,
+	                                  unsigned ms=UINT_MAX);
+
 	/**
 	 * Return true iff the pattern is totally abstract like
 	 *
@@ -344,10 +504,19 @@ public:
 	static bool totally_abstract(const Handle& pattern);
 
 	/**
-	 * Generate a list of hopefully unique random variables
+	 * Return the variable of index i, named $PM-<i>, and the list of
+	 * variables of indices 0 to n-1. Generated patterns only use these
+	 * positional variables, so that equal patterns are equal atoms,
+	 * and their memoized values (support, etc) can be shared.
+	 */
+	static Handle gen_variable(unsigned i);
+	static HandleSeq gen_variables(size_t n);
+
+	/**
+	 * Return the positional variable of lowest index whose name is not
+	 * in used.
 	 */
-	static HandleSeq gen_rand_variables(size_t n);
-	static Handle gen_rand_variable();
+	static Handle gen_fresh_variable(const std::set<std::string>& used);
 
 	/**
 	 * Given a pattern return its variables. If the pattern is not a
@@ -461,7 +630,7 @@ public:
 	 */
 	static HandleSet expand_conjunction_rec(const Handle& cnjtion,
 	                                        const Handle& pattern,
-	                                        const HandleSeq& db,
+	                                        const MinerDB& db,
 	                                        unsigned ms,
 	                                        unsigned mv,
 	                                        const HandleMap& pv2cv=HandleMap(),
@@ -475,7 +644,7 @@ public:
 	 */
 	static HandleSet expand_conjunction_es_rec(const Handle& cnjtion,
 	                                           const Handle& pattern,
-	                                           const HandleSeq& db,
+	                                           const MinerDB& db,
 	                                           unsigned ms,
 	                                           unsigned mv,
 	                                           const HandleMap& pv2cv=HandleMap(),
@@ -507,7 +676,7 @@ public:
 	 */
 	static HandleSet expand_conjunction(const Handle& cnjtion,
 	                                    const Handle& pattern,
-	                                    const HandleSeq& db,
+	                                    const MinerDB& db,
 	                                    unsigned ms,
 	                                    unsigned mv=UINT_MAX,
 	                                    bool es=true);
@@ -539,10 +708,112 @@ public:
 	 * memoization should not be used if ms is to be changed.
 	 */
 	static double support_mem(const Handle& pattern,
-	                          const HandleSeq& db,
-	                          unsigned ms);
+	                          const MinerDB& db,
+	                          unsigned ms,
+	                          const OccurrenceSet* occs=nullptr,
+	                          SupportCache* cache=nullptr);
+
+	/**
+	 * Return a key of pattern that is the same for all patterns
+	 * equivalent up to variable renaming and clause ordering. For
+	 * instance
+	 *
+	 * (Lambda
+	 *   (VariableList (Variable "$X") (Variable "$Y"))
+	 *   (Present
+	 *     (Inheritance (Variable "$X") (Concept "A"))
+	 *     (Inheritance (Variable "$Y") (Variable "$X"))))
+	 *
+	 * and
+	 *
+	 * (Lambda
+	 *   (VariableList (Variable "$Z") (Variable "$W"))
+	 *   (Present
+	 *     (Inheritance (Variable "$W") (Variable "$Z"))
+	 *     (Inheritance (Variable "$Z") (Concept "A"))))
+	 *
+	 * have the same key.
+	 *
+	 * The key is obtained by sorting the clauses according to their
+	 * serialization with all variables replaced by a placeholder,
+	 * then numbering the variables in order of appearance. Clauses
+	 * with the same serialization are tried in all orders (up to
+	 * max_canonical_permutations), keeping the lowest key.
+	 *
+	 * Since that may be costly, the key is memoized on pattern, as a
+	 * value attached to canonical_key_key().
+	 */
+	static std::string canonical_key(const Handle& pattern);
+	static const Handle& canonical_key_key();
+	static const unsigned max_canonical_permutations = 720;
+
+	/**
+	 * Return pattern with its clauses in canonical order, that is the
+	 * order used to build its canonical key, and its variables renamed
+	 * into positional variables (see gen_variable) following that
+	 * order. Two patterns with the same canonical key thus have the
+	 * same canonical pattern.
+	 *
+	 * If provided, renaming is filled with the mapping from the
+	 * variables of pattern to the variables of the canonical pattern.
+	 */
+	static Handle canonical_pattern(const Handle& pattern,
+	                                HandleMap* renaming=nullptr);
+
+	/**
+	 * Return a 64-bit hash of a canonical key (FNV-1a), and of the
+	 * canonical key of a pattern.
+	 */
+	static std::uint64_t canonical_hash(const std::string& key);
+	static std::uint64_t pattern_hash(const Handle& pattern);
+
+	/**
+	 * Return the generalizations of pattern that are one shallow
+	 * abstraction away from it, that is the patterns that pattern
+	 * can be obtained from by composing one of their variables with
+	 * a constant node or a single operator pattern (see
+	 * shallow_abstract_of_val). Variable factorizations are not
+	 * inverted. For instance
+	 *
+	 * (Lambda
+	 *   (VariableList (Variable "$X"))
+	 *   (Inheritance (Variable "$X") (Concept "A")))
+	 *
+	 * has generalization
+	 *
+	 * (Lambda
+	 *   (VariableList (Variable "$X") (Variable "$Y"))
+	 *   (Inheritance (Variable "$X") (Variable "$Y")))
+	 *
+	 * Generalizations with totally abstract components, like
+	 *
+	 * (Lambda
+	 *   (VariableList (Variable "$Y"))
+	 *   (Variable "$Y"))
+	 *
+	 * are excluded because their support is the size of the db (see
+	 * component_support), which may be lower than the support of
+	 * pattern.
+	 *
+	 * By anti-monotonicity of the support, if any of them does not
+	 * reach the minimum support, neither does pattern.
+	 */
+	static HandleSeq generalizations(const Handle& pattern);
+};
+
+/**
+ * Hash function for containers keyed by canonical keys.
+ */
+struct CanonicalKeyHash
+{
+	size_t operator()(const std::string& key) const
+	{
+		return MinerUtils::canonical_hash(key);
+	}
 };
 
+typedef std::unordered_set<std::string, CanonicalKeyHash> CanonicalKeySet;
+
 } // ~namespace opencog
 
 #endif /* OPENCOG_MINER_UTILS_H_ */
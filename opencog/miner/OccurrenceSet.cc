@@ -0,0 +1,369 @@
+/*
+ * OccurrenceSet.cc
+ *
+ * Copyright (C) 2026 OpenCog Foundation
+ *
+ * Author: agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "OccurrenceSet.h"
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+
+#include <opencog/util/oc_assert.h>
+
+// AVX2 kernels are compiled for x86-64 with GCC or Clang, regardless
+// of the compilation flags, and only used if the CPU supports them.
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MINER_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace opencog
+{
+
+static unsigned popcount64(std::uint64_t w)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(w);
+#else
+	w = w - ((w >> 1) & 0x5555555555555555ULL);
+	w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+	w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (w * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+static unsigned ctz64(std::uint64_t w)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(w);
+#else
+	unsigned n = 0;
+	while (not (w & 1)) {
+		w >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////
+// Kernels over bitmaps of n words, writing the AND, resp. OR, of //
+// a and b into out and returning its number of bits, in a single //
+// pass.                                                          //
+//////////////////////////////////////////////////////////////////
+
+typedef size_t (*BinaryKernel)(const std::uint64_t*, const std::uint64_t*,
+                               std::uint64_t*, size_t);
+
+static size_t and_portable(const std::uint64_t* a, const std::uint64_t* b,
+                           std::uint64_t* out, size_t n)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < n; i++) {
+		out[i] = a[i] & b[i];
+		count += popcount64(out[i]);
+	}
+	return count;
+}
+
+static size_t or_portable(const std::uint64_t* a, const std::uint64_t* b,
+                          std::uint64_t* out, size_t n)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < n; i++) {
+		out[i] = a[i] | b[i];
+		count += popcount64(out[i]);
+	}
+	return count;
+}
+
+#ifdef MINER_AVX2_KERNELS
+
+// Number of bits of each 64-bit lane of v, by looking up the number
+// of bits of each nibble, then summing the bytes of each lane.
+__attribute__((target("avx2")))
+static inline __m256i popcount256(__m256i v)
+{
+	const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+	                                        1, 2, 2, 3, 2, 3, 3, 4,
+	                                        0, 1, 1, 2, 1, 2, 2, 3,
+	                                        1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	__m256i lo = _mm256_and_si256(v, nibble),
+		hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble),
+		bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+		                        _mm256_shuffle_epi8(lookup, hi));
+	return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+// Sum of the 64-bit lanes of v
+__attribute__((target("avx2")))
+static inline size_t sum256(__m256i v)
+{
+	alignas(32) std::uint64_t lanes[4];
+	_mm256_store_si256((__m256i*)lanes, v);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+__attribute__((target("avx2")))
+static size_t and_avx2(const std::uint64_t* a, const std::uint64_t* b,
+                       std::uint64_t* out, size_t n)
+{
+	__m256i counts = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i va = _mm256_loadu_si256((const __m256i*)(a + i)),
+			vb = _mm256_loadu_si256((const __m256i*)(b + i)),
+			vo = _mm256_and_si256(va, vb);
+		_mm256_storeu_si256((__m256i*)(out + i), vo);
+		counts = _mm256_add_epi64(counts, popcount256(vo));
+	}
+	size_t count = sum256(counts);
+	for (; i < n; i++) {
+		out[i] = a[i] & b[i];
+		count += popcount64(out[i]);
+	}
+	return count;
+}
+
+__attribute__((target("avx2")))
+static size_t or_avx2(const std::uint64_t* a, const std::uint64_t* b,
+                      std::uint64_t* out, size_t n)
+{
+	__m256i counts = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i va = _mm256_loadu_si256((const __m256i*)(a + i)),
+			vb = _mm256_loadu_si256((const __m256i*)(b + i)),
+			vo = _mm256_or_si256(va, vb);
+		_mm256_storeu_si256((__m256i*)(out + i), vo);
+		counts = _mm256_add_epi64(counts, popcount256(vo));
+	}
+	size_t count = sum256(counts);
+	for (; i < n; i++) {
+		out[i] = a[i] | b[i];
+		count += popcount64(out[i]);
+	}
+	return count;
+}
+
+#endif // MINER_AVX2_KERNELS
+
+struct Kernels
+{
+	BinaryKernel and_words;
+	BinaryKernel or_words;
+};
+
+static Kernels select_kernels()
+{
+#ifdef MINER_AVX2_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return {and_avx2, or_avx2};
+#endif
+	return {and_portable, or_portable};
+}
+
+static const Kernels& kernels()
+{
+	static const Kernels selected = select_kernels();
+	return selected;
+}
+
+///////////////////
+// OccurrenceSet //
+///////////////////
+
+OccurrenceSet::OccurrenceSet(size_t universe)
+	: _universe(universe), _size(0), _dense(false) {}
+
+OccurrenceSet::OccurrenceSet(const IndexSeq& indices, size_t universe)
+	: _universe(universe), _size(indices.size()), _dense(false),
+	  _indices(indices.begin(), indices.end())
+{
+	adapt();
+}
+
+size_t OccurrenceSet::universe() const
+{
+	return _universe;
+}
+
+size_t OccurrenceSet::size() const
+{
+	return _size;
+}
+
+bool OccurrenceSet::empty() const
+{
+	return _size == 0;
+}
+
+bool OccurrenceSet::dense() const
+{
+	return _dense;
+}
+
+bool OccurrenceSet::contains(unsigned i) const
+{
+	if (_dense)
+		return i < _universe and (_words[i / 64] >> (i % 64)) & 1;
+	return std::binary_search(_indices.begin(), _indices.end(), i);
+}
+
+void OccurrenceSet::insert(unsigned i)
+{
+	OC_ASSERT(i < _universe, "Index out of the universe");
+	if (_dense) {
+		std::uint64_t bit = std::uint64_t(1) << (i % 64);
+		if (not (_words[i / 64] & bit)) {
+			_words[i / 64] |= bit;
+			_size++;
+		}
+		return;
+	}
+	if (_indices.empty() or _indices.back() < i) {
+		_indices.push_back(i);
+		_size++;
+		return;
+	}
+	auto it = std::lower_bound(_indices.begin(), _indices.end(), i);
+	if (*it != i) {
+		_indices.insert(it, i);
+		_size++;
+	}
+}
+
+void OccurrenceSet::adapt()
+{
+	bool compact_dense = _universe <= 32 * _size;
+	if (compact_dense and not _dense)
+		to_dense();
+	else if (not compact_dense and _dense)
+		to_sparse();
+}
+
+OccurrenceSet OccurrenceSet::intersect(const OccurrenceSet& other) const
+{
+	OC_ASSERT(_universe == other._universe, "Universes differ");
+	OccurrenceSet result(_universe);
+	if (_dense and other._dense) {
+		size_t n = _words.size();
+		result._dense = true;
+		result._words.resize(n);
+		result._size = kernels().and_words(_words.data(), other._words.data(),
+		                                   result._words.data(), n);
+	} else if (_dense or other._dense) {
+		const OccurrenceSet& sparse = _dense ? other : *this;
+		const OccurrenceSet& dense = _dense ? *this : other;
+		for (unsigned i : sparse._indices)
+			if (dense.contains(i))
+				result._indices.push_back(i);
+		result._size = result._indices.size();
+	} else {
+		std::set_intersection(_indices.begin(), _indices.end(),
+		                      other._indices.begin(), other._indices.end(),
+		                      std::back_inserter(result._indices));
+		result._size = result._indices.size();
+	}
+	result.adapt();
+	return result;
+}
+
+OccurrenceSet OccurrenceSet::unite(const OccurrenceSet& other) const
+{
+	OC_ASSERT(_universe == other._universe, "Universes differ");
+	OccurrenceSet result(_universe);
+	if (_dense and other._dense) {
+		size_t n = _words.size();
+		result._dense = true;
+		result._words.resize(n);
+		result._size = kernels().or_words(_words.data(), other._words.data(),
+		                                  result._words.data(), n);
+	} else if (_dense or other._dense) {
+		const OccurrenceSet& sparse = _dense ? other : *this;
+		result = _dense ? *this : other;
+		for (unsigned i : sparse._indices)
+			result.insert(i);
+	} else {
+		std::set_union(_indices.begin(), _indices.end(),
+		               other._indices.begin(), other._indices.end(),
+		               std::back_inserter(result._indices));
+		result._size = result._indices.size();
+	}
+	result.adapt();
+	return result;
+}
+
+OccurrenceSet::IndexSeq OccurrenceSet::indices() const
+{
+	if (not _dense)
+		return IndexSeq(_indices.begin(), _indices.end());
+
+	IndexSeq result;
+	result.reserve(_size);
+	for (size_t w = 0; w < _words.size(); w++)
+		for (std::uint64_t word = _words[w]; word; word &= word - 1)
+			result.push_back(w * 64 + ctz64(word));
+	return result;
+}
+
+bool OccurrenceSet::operator==(const OccurrenceSet& other) const
+{
+	return _universe == other._universe and _size == other._size
+		and indices() == other.indices();
+}
+
+void OccurrenceSet::to_dense()
+{
+	_words.assign((_universe + 63) / 64, 0);
+	for (unsigned i : _indices)
+		_words[i / 64] |= std::uint64_t(1) << (i % 64);
+	std::vector<std::uint32_t>().swap(_indices);
+	_dense = true;
+}
+
+void OccurrenceSet::to_sparse()
+{
+	IndexSeq idxs = indices();
+	_indices.assign(idxs.begin(), idxs.end());
+	std::vector<std::uint64_t>().swap(_words);
+	_dense = false;
+}
+
+std::string OccurrenceSet::to_string(const std::string& indent) const
+{
+	std::stringstream ss;
+	ss << indent << "size = " << _size << ", universe = " << _universe
+	   << (_dense ? ", dense" : ", sparse") << std::endl << indent;
+	for (unsigned i : indices())
+		ss << i << " ";
+	return ss.str();
+}
+
+std::string oc_to_string(const OccurrenceSet& occs, const std::string& indent)
+{
+	return occs.to_string(indent);
+}
+
+} // namespace opencog
@@ -0,0 +1,135 @@
+/*
+ * OccurrenceSet.h
+ *
+ * Copyright (C) 2026 OpenCog Foundation
+ *
+ * Author: agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef OPENCOG_OCCURRENCE_SET_H_
+#define OPENCOG_OCCURRENCE_SET_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <opencog/util/empty_string.h>
+
+namespace opencog
+{
+
+/**
+ * Set of indices of data trees of a db, ranging from 0 to the size of
+ * the db, its universe, excluded. Typically used to store where a
+ * pattern occurs.
+ *
+ * It is either sparse, a sorted array of indices, or dense, a bitmap
+ * over the universe, whichever is the most compact. The operations
+ * over dense sets compute the resulting bitmap and its size in a
+ * single pass, using AVX2 kernels if the CPU supports them, selected
+ * at runtime, and portable ones otherwise.
+ */
+class OccurrenceSet
+{
+public:
+	typedef std::vector<unsigned> IndexSeq;
+
+	/**
+	 * Construct an empty set over the given universe.
+	 */
+	OccurrenceSet(size_t universe=0);
+
+	/**
+	 * Construct a set over the given universe from the given indices,
+	 * sorted in increasing order.
+	 */
+	OccurrenceSet(const IndexSeq& indices, size_t universe);
+
+	/**
+	 * Return the size of the universe.
+	 */
+	size_t universe() const;
+
+	/**
+	 * Return the number of indices in the set.
+	 */
+	size_t size() const;
+
+	bool empty() const;
+
+	/**
+	 * Return true iff the set is represented as a bitmap.
+	 */
+	bool dense() const;
+
+	bool contains(unsigned i) const;
+
+	/**
+	 * Insert an index. Only efficient if the set is dense or i is
+	 * greater than all its indices. Call adapt once done inserting.
+	 */
+	void insert(unsigned i);
+
+	/**
+	 * Switch to the most compact representation, that is dense if
+	 * there are more than one index per 32 of the universe.
+	 */
+	void adapt();
+
+	/**
+	 * Return the intersection, resp. union, of this and other, which
+	 * must have the same universe.
+	 */
+	OccurrenceSet intersect(const OccurrenceSet& other) const;
+	OccurrenceSet unite(const OccurrenceSet& other) const;
+
+	/**
+	 * Return the indices in increasing order.
+	 */
+	IndexSeq indices() const;
+
+	bool operator==(const OccurrenceSet& other) const;
+
+	std::string to_string(const std::string& indent=empty_string) const;
+
+private:
+	/**
+	 * Convert to dense, resp. sparse, representation.
+	 */
+	void to_dense();
+	void to_sparse();
+
+	size_t _universe;
+
+	// Number of indices, maintained for both representations
+	size_t _size;
+
+	bool _dense;
+
+	// Sparse representation, sorted indices
+	std::vector<std::uint32_t> _indices;
+
+	// Dense representation, bitmap of 64-bit words
+	std::vector<std::uint64_t> _words;
+};
+
+std::string oc_to_string(const OccurrenceSet& occs,
+                         const std::string& indent=empty_string);
+
+} // ~namespace opencog
+
+#endif /* OPENCOG_OCCURRENCE_SET_H_ */
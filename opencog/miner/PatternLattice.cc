@@ -0,0 +1,119 @@
+/*
+ * PatternLattice.cc
+ *
+ * Copyright (C) 2026 OpenCog Foundation
+ *
+ * Author: agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "PatternLattice.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace opencog
+{
+
+const PatternLattice::NodeId PatternLattice::npos;
+
+PatternLattice::NodeId PatternLattice::insert(const Handle& pattern,
+                                              unsigned support)
+{
+	NodeId id = _nodes.size();
+	auto it = _ids.insert({MinerUtils::canonical_key(pattern), id});
+	if (it.second)
+		_nodes.push_back({pattern, support, {}, {}});
+	return it.first->second;
+}
+
+bool PatternLattice::connect(NodeId parent, NodeId child)
+{
+	NodeIdSeq& children = _nodes[parent].children;
+	if (std::find(children.begin(), children.end(), child) != children.end())
+		return false;
+	children.push_back(child);
+	_nodes[child].parents.push_back(parent);
+	return true;
+}
+
+PatternLattice::NodeId PatternLattice::find(const Handle& pattern) const
+{
+	auto it = _ids.find(MinerUtils::canonical_key(pattern));
+	return it == _ids.end() ? npos : it->second;
+}
+
+const PatternLattice::Node& PatternLattice::operator[](NodeId id) const
+{
+	return _nodes[id];
+}
+
+size_t PatternLattice::size() const
+{
+	return _nodes.size();
+}
+
+bool PatternLattice::empty() const
+{
+	return _nodes.empty();
+}
+
+PatternLattice::NodeIdSeq PatternLattice::roots() const
+{
+	NodeIdSeq ids;
+	for (NodeId id = 0; id < _nodes.size(); id++)
+		if (_nodes[id].parents.empty())
+			ids.push_back(id);
+	return ids;
+}
+
+HandleSeq PatternLattice::patterns() const
+{
+	HandleSeq pats;
+	pats.reserve(_nodes.size());
+	for (const Node& node : _nodes)
+		pats.push_back(node.pattern);
+	return pats;
+}
+
+std::string PatternLattice::to_string(const std::string& indent) const
+{
+	std::stringstream ss;
+	ss << indent << "size = " << _nodes.size();
+	for (NodeId id = 0; id < _nodes.size(); id++) {
+		const Node& node = _nodes[id];
+		ss << std::endl << indent << "node[" << id << "]:" << std::endl
+		   << indent << OC_TO_STRING_INDENT << "support = " << node.support
+		   << std::endl << indent << OC_TO_STRING_INDENT << "parents =";
+		for (NodeId pid : node.parents)
+			ss << " " << pid;
+		ss << std::endl << indent << OC_TO_STRING_INDENT << "children =";
+		for (NodeId cid : node.children)
+			ss << " " << cid;
+		ss << std::endl << oc_to_string(node.pattern,
+		                                indent + OC_TO_STRING_INDENT);
+	}
+	return ss.str();
+}
+
+std::string oc_to_string(const PatternLattice& lattice,
+                         const std::string& indent)
+{
+	return lattice.to_string(indent);
+}
+
+} // namespace opencog
@@ -0,0 +1,124 @@
+/*
+ * PatternLattice.h
+ *
+ * Copyright (C) 2026 OpenCog Foundation
+ *
+ * Author: agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef OPENCOG_PATTERN_LATTICE_H_
+#define OPENCOG_PATTERN_LATTICE_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <opencog/util/empty_string.h>
+#include <opencog/atoms/base/Handle.h>
+
+#include "MinerUtils.h"
+
+namespace opencog
+{
+
+/**
+ * Lattice of patterns, that is a directed acyclic graph with one node
+ * per pattern, up to variable renaming and clause ordering (see
+ * MinerUtils::canonical_key), linked to its parents, the patterns it
+ * is a specialization of, and to its children, the patterns it is a
+ * generalization of. Each node holds the support of its pattern.
+ *
+ * Unlike a HandleTree, a pattern reached from several parents is
+ * stored once, and navigating between generalizations and
+ * specializations takes a constant time per edge.
+ *
+ * It is not thread safe.
+ */
+class PatternLattice
+{
+public:
+	typedef unsigned NodeId;
+	typedef std::vector<NodeId> NodeIdSeq;
+
+	/**
+	 * Identifier returned by find for patterns not in the lattice.
+	 */
+	static const NodeId npos = (NodeId)-1;
+
+	struct Node
+	{
+		Handle pattern;
+		unsigned support;
+		NodeIdSeq parents;
+		NodeIdSeq children;
+	};
+
+	/**
+	 * Insert pattern with the given support, unless already present,
+	 * and return its identifier.
+	 */
+	NodeId insert(const Handle& pattern, unsigned support);
+
+	/**
+	 * Add an edge from parent to child. Return false if it is
+	 * already present.
+	 */
+	bool connect(NodeId parent, NodeId child);
+
+	/**
+	 * Return the identifier of pattern, or npos if it is not present.
+	 */
+	NodeId find(const Handle& pattern) const;
+
+	/**
+	 * Access the node of the given identifier. Identifiers range from
+	 * 0 to size() - 1, in order of insertion.
+	 */
+	const Node& operator[](NodeId id) const;
+
+	/**
+	 * Return the number of nodes.
+	 */
+	size_t size() const;
+
+	bool empty() const;
+
+	/**
+	 * Return the identifiers of the nodes without parents.
+	 */
+	NodeIdSeq roots() const;
+
+	/**
+	 * Return the patterns of all nodes, in order of insertion.
+	 */
+	HandleSeq patterns() const;
+
+	std::string to_string(const std::string& indent=empty_string) const;
+
+private:
+	std::vector<Node> _nodes;
+
+	// Map canonical keys of patterns to their identifiers
+	std::unordered_map<std::string, NodeId, CanonicalKeyHash> _ids;
+};
+
+std::string oc_to_string(const PatternLattice& lattice,
+                         const std::string& indent=empty_string);
+
+} // ~namespace opencog
+
+#endif /* OPENCOG_PATTERN_LATTICE_H_ */
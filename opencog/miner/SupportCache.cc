@@ -0,0 +1,142 @@
+/*
+ * SupportCache.cc
+ *
+ * Copyright (C) 2026 OpenCog Foundation
+ *
+ * Author: agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SupportCache.h"
+
+#include <algorithm>
+#include <climits>
+#include <sstream>
+
+namespace opencog
+{
+
+SupportCache::SupportCache() : _db_id(0) {}
+
+bool SupportCache::lookup(const std::string& key, const MinerDB& db,
+                          unsigned ms, bool& enough) const
+{
+	std::lock_guard<std::mutex> lock(_mtx);
+	use_db(db);
+	auto it = _entries.find(key);
+	if (it == _entries.end())
+		return false;
+	const Bounds& bounds = it->second;
+	if (ms <= bounds.lower) {
+		enough = true;
+		return true;
+	}
+	if (bounds.upper < ms) {
+		enough = false;
+		return true;
+	}
+	return false;
+}
+
+bool SupportCache::support(const std::string& key, const MinerDB& db,
+                           unsigned ms, unsigned& support) const
+{
+	std::lock_guard<std::mutex> lock(_mtx);
+	use_db(db);
+	auto it = _entries.find(key);
+	if (it == _entries.end())
+		return false;
+	const Bounds& bounds = it->second;
+	if (bounds.lower == bounds.upper or ms <= bounds.lower) {
+		support = bounds.lower;
+		return true;
+	}
+	return false;
+}
+
+bool SupportCache::infrequent(const std::string& key, const MinerDB& db,
+                              unsigned ms) const
+{
+	bool enough;
+	return lookup(key, db, ms, enough) and not enough;
+}
+
+void SupportCache::insert(const std::string& key, const MinerDB& db,
+                          unsigned support, unsigned ms)
+{
+	insert(key, db, {support, support < ms ? support : UINT_MAX});
+}
+
+void SupportCache::insert_infrequent(const std::string& key,
+                                     const MinerDB& db, unsigned ms)
+{
+	if (0 < ms)
+		insert(key, db, {0, ms - 1});
+}
+
+void SupportCache::clear()
+{
+	std::lock_guard<std::mutex> lock(_mtx);
+	_entries.clear();
+	_db_id = 0;
+}
+
+size_t SupportCache::size() const
+{
+	std::lock_guard<std::mutex> lock(_mtx);
+	return _entries.size();
+}
+
+void SupportCache::insert(const std::string& key, const MinerDB& db,
+                          const Bounds& bounds)
+{
+	std::lock_guard<std::mutex> lock(_mtx);
+	use_db(db);
+	auto it = _entries.find(key);
+	if (it == _entries.end()) {
+		_entries.insert({key, bounds});
+		return;
+	}
+	it->second.lower = std::max(it->second.lower, bounds.lower);
+	it->second.upper = std::min(it->second.upper, bounds.upper);
+}
+
+void SupportCache::use_db(const MinerDB& db) const
+{
+	if (_db_id != db.id()) {
+		_entries.clear();
+		_db_id = db.id();
+	}
+}
+
+std::string SupportCache::to_string(const std::string& indent) const
+{
+	std::lock_guard<std::mutex> lock(_mtx);
+	std::stringstream ss;
+	ss << indent << "size = " << _entries.size();
+	for (const auto& entry : _entries)
+		ss << std::endl << indent << entry.first << " : ["
+		   << entry.second.lower << ", " << entry.second.upper << "]";
+	return ss.str();
+}
+
+std::string oc_to_string(const SupportCache& sc, const std::string& indent)
+{
+	return sc.to_string(indent);
+}
+
+} // namespace opencog
@@ -0,0 +1,137 @@
+/*
+ * SupportCache.h
+ *
+ * Copyright (C) 2026 OpenCog Foundation
+ *
+ * Author: agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef OPENCOG_SUPPORT_CACHE_H_
+#define OPENCOG_SUPPORT_CACHE_H_
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <opencog/util/empty_string.h>
+
+#include "MinerDB.h"
+#include "MinerUtils.h"
+
+namespace opencog
+{
+
+/**
+ * Cache of pattern supports w.r.t. a db, keyed by canonical pattern
+ * keys (see MinerUtils::canonical_key), so that alpha-equivalent
+ * patterns, reached from different branches of the specialization
+ * tree, share the same entry.
+ *
+ * Since supports are typically calculated up to a minimum support,
+ * an entry holds bounds rather than an exact value. Lower and upper
+ * bounds are equal when the support is exactly known.
+ *
+ * The cache is thread safe. It is tied to a db, if used with another
+ * one it is cleared beforehand.
+ */
+class SupportCache
+{
+public:
+	SupportCache();
+
+	/**
+	 * Return true iff whether pattern key reaches ms w.r.t. db is
+	 * known, in which case it is stored in enough.
+	 */
+	bool lookup(const std::string& key, const MinerDB& db,
+	            unsigned ms, bool& enough) const;
+
+	/**
+	 * Return true iff the support of pattern key w.r.t. db, calculated
+	 * up to ms (see MinerUtils::support), is known, in which case it
+	 * is stored in support. That is if it is exactly known, or known
+	 * to reach ms.
+	 */
+	bool support(const std::string& key, const MinerDB& db,
+	             unsigned ms, unsigned& support) const;
+
+	/**
+	 * Return true iff pattern key is known not to reach ms w.r.t. db.
+	 */
+	bool infrequent(const std::string& key, const MinerDB& db,
+	                unsigned ms) const;
+
+	/**
+	 * Insert the support of pattern key w.r.t. db, calculated up to
+	 * ms (see MinerUtils::support). That is if support is below ms
+	 * then it is exact, otherwise it is a lower bound.
+	 */
+	void insert(const std::string& key, const MinerDB& db,
+	            unsigned support, unsigned ms);
+
+	/**
+	 * Insert that pattern key does not reach ms w.r.t. db, for
+	 * instance because one of its generalizations does not.
+	 */
+	void insert_infrequent(const std::string& key, const MinerDB& db,
+	                       unsigned ms);
+
+	/**
+	 * Remove all entries.
+	 */
+	void clear();
+
+	/**
+	 * Return the number of entries.
+	 */
+	size_t size() const;
+
+	std::string to_string(const std::string& indent=empty_string) const;
+
+private:
+	struct Bounds {
+		unsigned lower;
+		unsigned upper;
+	};
+
+	/**
+	 * Insert bounds, intersected with the existing ones if any.
+	 */
+	void insert(const std::string& key, const MinerDB& db,
+	            const Bounds& bounds);
+
+	/**
+	 * Clear the cache if db is not the one it is tied to. Assumes the
+	 * lock is held.
+	 */
+	void use_db(const MinerDB& db) const;
+
+	mutable std::mutex _mtx;
+
+	// Identifier of the db the entries are calculated against, 0 if
+	// none (see MinerDB::id).
+	mutable std::uint64_t _db_id;
+
+	mutable std::unordered_map<std::string, Bounds, CanonicalKeyHash> _entries;
+};
+
+std::string oc_to_string(const SupportCache& sc,
+                         const std::string& indent=empty_string);
+
+} // ~namespace opencog
+
+#endif /* OPENCOG_SUPPORT_CACHE_H_ */
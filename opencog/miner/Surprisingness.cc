@@ -30,6 +30,7 @@
 #include <opencog/util/dorepeat.h>
 #include <opencog/util/algorithm.h>
 #include <opencog/util/empty_string.h>
+#include <opencog/util/exceptions.h>
 #include <opencog/atomspace/AtomSpace.h>
 #include <opencog/atoms/base/Link.h>
 #include <opencog/atoms/base/Node.h>
@@ -47,14 +48,16 @@
 #include <boost/range/numeric.hpp>
 #include <boost/math/special_functions/binomial.hpp>
 
+#include <algorithm>
 #include <cmath>
 #include <functional>
 #include <limits>
+#include <queue>
 
 namespace opencog {
 
 double Surprisingness::isurp_old(const Handle& pattern,
-                                 const HandleSeq& db,
+                                 const MinerDB& db,
                                  bool normalize)
 {
 	// Strictly speaking it should be the power but we use binomial for
@@ -92,8 +95,9 @@ double Surprisingness::isurp_old(const Handle& pattern,
 }
 
 double Surprisingness::isurp(const Handle& pattern,
-                             const HandleSeq& db,
-                             bool normalize)
+                             const MinerDB& db,
+                             bool normalize,
+                             bool subsample)
 {
 	// Calculate the probability estimate of each partition based on
 	// independent assumption of between each partition block, taking
@@ -107,8 +111,9 @@ double Surprisingness::isurp(const Handle& pattern,
 	double emin = *mmp.first, emax = *mmp.second;
 
 	// Calculate the empirical probability of pattern, using
-	// boostrapping if necessary
-	double emp = emp_prob_pbs_mem(pattern, db, emax);
+	// boostrapping if necessary and allowed
+	double emp = subsample ? emp_prob_pbs_mem(pattern, db, emax)
+		: emp_prob_mem(pattern, db);
 
 	// Calculate the I-Surprisingness, normalized if requested.
 	double dst = dst_from_interval(emin, emax, emp);
@@ -116,6 +121,99 @@ double Surprisingness::isurp(const Handle& pattern,
 	return std::min(normalize ? dst / maxprb : dst, 1.0);
 }
 
+double Surprisingness::isurp_upper_bound(const Handle& pattern,
+                                         const MinerDB& db,
+                                         bool normalize)
+{
+	HandleSeqSeqSeq prtns = partitions_without_pattern(pattern);
+	if (prtns.empty())
+		return 0.0;
+
+	// Calculate the bounds of the estimates of the partitions, lmax
+	// is the highest lower bound, umin and umax the lowest and highest
+	// upper bounds.
+	double M = std::max((double)db.size(), (double)db.n_values());
+	double lmax = 0.0, umin = 1.0, umax = 0.0;
+	for (const HandleSeqSeq& partition : prtns) {
+		// Product of the empirical probabilities of the blocks
+		double p = 1.0;
+		for (const Handle& subpattern :
+			     add_subpatterns(partition, pattern, *pattern->getAtomSpace()))
+			p *= emp_prob_mem(subpattern, db);
+
+		// Number of equalities between joint variables
+		double n_eqs = 0;
+		for (const Handle& var : joint_variables(pattern, partition)) {
+			n_eqs--;
+			for (const HandleSeq& blk : partition)
+				if (is_free_in_any_tree(blk, var))
+					n_eqs++;
+		}
+
+		lmax = std::max(lmax, p * std::pow(M, -n_eqs));
+		umin = std::min(umin, p);
+		umax = std::max(umax, p);
+	}
+
+	// Calculate the bounds of the empirical probability of pattern
+	double sup = MinerUtils::get_support(pattern);
+	double emp_hi = umin,
+		emp_lo = 0 < sup ?
+		std::min(sup / universe_count(pattern, db), emp_hi) : 0.0;
+
+	// Bound the distance between the empirical probability and the
+	// estimates, if above, then if below them.
+	double ub = 0.0;
+	if (lmax < emp_hi)
+		ub = normalize ? 1.0 - lmax / emp_hi : emp_hi - lmax;
+	if (emp_lo < umin)
+		ub = std::max(ub, normalize ? 1.0 - emp_lo / umax : umin - emp_lo);
+	return std::min(ub, 1.0);
+}
+
+ScoredPatternSeq Surprisingness::isurp_topk(const HandleSeq& patterns,
+                                            const MinerDB& db,
+                                            unsigned k,
+                                            bool normalize)
+{
+	if (k == 0)
+		return {};
+
+	// Sort patterns by decreasing upper bound. Patterns with a single
+	// conjunct have no partition, thus an upper bound of 0.
+	ScoredPatternSeq bounded;
+	for (const Handle& pattern : patterns)
+		bounded.push_back({pattern, isurp_upper_bound(pattern, db, normalize)});
+	auto higher = [](const ScoredPattern& l, const ScoredPattern& r) {
+		return l.second > r.second;
+	};
+	std::stable_sort(bounded.begin(), bounded.end(), higher);
+
+	// Keep the k best patterns found so far, the worst on top. Stop as
+	// soon as the remaining patterns cannot beat it.
+	std::priority_queue<ScoredPattern, ScoredPatternSeq, decltype(higher)>
+		best(higher);
+	for (const ScoredPattern& pb : bounded) {
+		if (best.size() == k and pb.second <= best.top().second)
+			break;
+		// Use exact empirical probabilities, as assumed by the bound
+		double surp = 1 < MinerUtils::n_conjuncts(pb.first) ?
+			isurp(pb.first, db, normalize, false) : 0.0;
+		if (best.size() < k)
+			best.push({pb.first, surp});
+		else if (best.top().second < surp) {
+			best.pop();
+			best.push({pb.first, surp});
+		}
+	}
+
+	ScoredPatternSeq results;
+	for (; not best.empty(); best.pop())
+		results.push_back(best.top());
+	std::reverse(results.begin(), results.end());
+	return results;
+}
+
 double Surprisingness::dst_from_interval(double l, double u, double v)
 {
 	return (u < v ? v - u : (v < l ? l - v : 0.0));
@@ -217,26 +315,37 @@ HandleSeq Surprisingness::joint_variables(const Handle& pattern,
 
 unsigned Surprisingness::value_count(const HandleSeq& block,
                                      const Handle& var,
-                                     const HandleSeq& db)
+                                     const MinerDB& db)
 {
-	Valuations vs(MinerUtils::mk_pattern_no_vardecl(block), db);
-	HandleUCounter values = vs.values(var);
-	return values.keys().size();
+	SCValuations scv = var_scvaluations(block, var, db);
+	return scv.distinct_values(scv.index(var));
 }
 
 HandleCounter Surprisingness::value_distribution(const HandleSeq& block,
                                                  const Handle& var,
-                                                 const HandleSeq& db)
+                                                 const MinerDB& db)
 {
-	Valuations vs(MinerUtils::mk_pattern_no_vardecl(block), db);
-	HandleUCounter values = vs.values(var);
+	SCValuations scv = var_scvaluations(block, var, db);
+	const ValueIdCounter& values = scv.histogram(scv.index(var));
 	HandleCounter dist;
-	double total = values.total_count();
+	double total = scv.size();
 	for (const auto& v : values)
-		dist[v.first] = v.second / total;
+		dist[scv.db.value(v.first)] = v.second / total;
 	return dist;
 }
 
+SCValuations Surprisingness::var_scvaluations(const HandleSeq& block,
+                                             const Handle& var,
+                                             const MinerDB& db)
+{
+	Handle pattern = MinerUtils::mk_pattern_no_vardecl(block);
+	pattern = MinerUtils::remove_useless_clauses(pattern);
+	for (const Handle& cp : MinerUtils::get_component_patterns(pattern))
+		if (MinerUtils::get_variables(cp).is_in_varset(var))
+			return SCValuations(cp, db);
+	throw RuntimeException(TRACE_INFO, "There's likely a bug");
+}
+
 double Surprisingness::inner_product(const std::vector<HandleCounter>& dists)
 {
 	// Find the common intersection of values
@@ -257,19 +366,19 @@ double Surprisingness::inner_product(const std::vector<HandleCounter>& dists)
 }
 
 double Surprisingness::universe_count(const Handle& pattern,
-                                      const HandleSeq& db)
+                                      const MinerDB& db)
 {
 	return std::pow((double)db.size(), MinerUtils::n_conjuncts(pattern));
 }
 
 double Surprisingness::prob_to_support(const Handle& pattern,
-                                       const HandleSeq& db,
+                                       const MinerDB& db,
                                        double prob)
 {
 	return prob * universe_count(pattern, db);
 }
 
-double Surprisingness::emp_prob(const Handle& pattern, const HandleSeq& db)
+double Surprisingness::emp_prob(const Handle& pattern, const MinerDB& db)
 {
 	double ucount = universe_count(pattern, db);
 	unsigned ms = (unsigned)std::min((double)UINT_MAX, ucount);
@@ -277,10 +386,12 @@ double Surprisingness::emp_prob(const Handle& pattern, const HandleSeq& db)
 	return sup / ucount;
 }
 
-double Surprisingness::emp_prob_mem(const Handle& pattern, const HandleSeq& db)
+double Surprisingness::emp_prob_mem(const Handle& pattern, const MinerDB& db)
 {
+	// Only reuse exact empirical probabilities, not estimates
+	// memoized by emp_prob_pbs_mem or emp_tv_mem.
 	TruthValuePtr emp_prob_tv = get_emp_tv(pattern);
-	if (emp_prob_tv) {
+	if (emp_prob_tv and emp_prob_tv->get_confidence() == 1.0) {
 		return emp_prob_tv->get_mean();
 	}
 	double ep = emp_prob(pattern, db);
@@ -289,15 +400,15 @@ double Surprisingness::emp_prob_mem(const Handle& pattern, const HandleSeq& db)
 }
 
 double Surprisingness::emp_prob_subsmp(const Handle& pattern,
-                                       const HandleSeq& db,
+                                       const MinerDB& db,
                                        unsigned subsize)
 {
-	return emp_prob(pattern,
-	                subsize < db.size() ?
-	                subsmp(db, subsize) : db);
+	if (subsize < db.size())
+		return emp_prob(pattern, MinerDB(subsmp(db.handles(), subsize)));
+	return emp_prob(pattern, db);
 }
 
-TruthValuePtr Surprisingness::emp_tv(const Handle& pattern, const HandleSeq& db)
+TruthValuePtr Surprisingness::emp_tv(const Handle& pattern, const MinerDB& db)
 {
 	double ucount = universe_count(pattern, db);
 	unsigned ms = (unsigned)std::min((double)UINT_MAX, ucount);
@@ -311,7 +422,7 @@ TruthValuePtr Surprisingness::emp_tv(const Handle& pattern, const HandleSeq& db)
 }
 
 TruthValuePtr Surprisingness::emp_tv_mem(const Handle& pattern,
-                                         const HandleSeq& db)
+                                         const MinerDB& db)
 {
 	TruthValuePtr etv = get_emp_tv(pattern);
 	if (etv) {
@@ -323,16 +434,16 @@ TruthValuePtr Surprisingness::emp_tv_mem(const Handle& pattern,
 }
 
 TruthValuePtr Surprisingness::emp_tv_subsmp(const Handle& pattern,
-                                            const HandleSeq& db,
+                                            const MinerDB& db,
                                             unsigned subsize)
 {
-	return emp_tv(pattern,
-	              subsize < db.size() ?
-	              subsmp(db, subsize) : db);
+	if (subsize < db.size())
+		return emp_tv(pattern, MinerDB(subsmp(db.handles(), subsize)));
+	return emp_tv(pattern, db);
 }
 
 double Surprisingness::emp_prob_bs(const Handle& pattern,
-                                   const HandleSeq& db,
+                                   const MinerDB& db,
                                    unsigned n_resample,
                                    unsigned subsize)
 {
@@ -347,7 +458,7 @@ double Surprisingness::emp_prob_bs(const Handle& pattern,
 }
 
 double Surprisingness::emp_prob_pbs(const Handle& pattern,
-                                    const HandleSeq& db,
+                                    const MinerDB& db,
                                     double prob_estimate)
 {
 	// Calculate an estimate of the support of the pattern to decide
@@ -369,7 +480,7 @@ double Surprisingness::emp_prob_pbs(const Handle& pattern,
 }
 
 double Surprisingness::emp_prob_pbs_mem(const Handle& pattern,
-                                        const HandleSeq& db,
+                                        const MinerDB& db,
                                         double prob_estimate)
 {
 	TruthValuePtr etv = get_emp_tv(pattern);
@@ -377,12 +488,15 @@ double Surprisingness::emp_prob_pbs_mem(const Handle& pattern,
 		return etv->get_mean();
 	}
 	double ep = emp_prob_pbs(pattern, db, prob_estimate);
-	set_emp_prob(pattern, ep);
+	// Lower the confidence if subsampled so that emp_prob_mem does
+	// not mistake it for an exact empirical probability.
+	bool subsampled = db.size() < prob_to_support(pattern, db, prob_estimate);
+	set_emp_prob(pattern, ep, subsampled ? 1e-1 : 1.0);
 	return ep;
 }
 
 TruthValuePtr Surprisingness::emp_tv_bs(const Handle& pattern,
-                                        const HandleSeq& db,
+                                        const MinerDB& db,
                                         unsigned n_resample,
                                         unsigned subsize)
 {
@@ -398,7 +512,7 @@ TruthValuePtr Surprisingness::emp_tv_bs(const Handle& pattern,
 }
 
 TruthValuePtr Surprisingness::emp_tv_pbs(const Handle& pattern,
-                                         const HandleSeq& db,
+                                         const MinerDB& db,
                                          double prob_estimate)
 {
 	// Calculate an estimate of the support of the pattern to decide
@@ -420,7 +534,7 @@ TruthValuePtr Surprisingness::emp_tv_pbs(const Handle& pattern,
 }
 
 TruthValuePtr Surprisingness::emp_tv_pbs_mem(const Handle& pattern,
-                                             const HandleSeq& db,
+                                             const MinerDB& db,
                                              double prob_estimate)
 {
 	TruthValuePtr etv = get_emp_tv(pattern);
@@ -460,7 +574,7 @@ HandleSeq Surprisingness::subsmp(const HandleSeq& db, unsigned subsize)
 }
 
 unsigned Surprisingness::subsmp_size(const Handle& pattern,
-                                     const HandleSeq& db,
+                                     const MinerDB& db,
                                      double support_estimate)
 {
 	double ts = db.size();
@@ -472,7 +586,7 @@ unsigned Surprisingness::subsmp_size(const Handle& pattern,
 
 double Surprisingness::ji_prob_est(const HandleSeqSeq& partition,
                                    const Handle& pattern,
-                                   const HandleSeq& db)
+                                   const MinerDB& db)
 {
 	// Generate subpatterns from blocks (add them in the atomspace to
 	// memoize support calculation)
@@ -497,7 +611,7 @@ double Surprisingness::ji_prob_est(const HandleSeqSeq& partition,
 
 TruthValuePtr Surprisingness::ji_tv_est(const HandleSeqSeq& partition,
                                         const Handle& pattern,
-                                        const HandleSeq& db)
+                                        const MinerDB& db)
 {
 	// Generate subpatterns from blocks (add them in the atomspace to
 	// memoize support calculation)
@@ -529,7 +643,7 @@ TruthValuePtr Surprisingness::ji_tv_est(const HandleSeqSeq& partition,
 }
 
 TruthValuePtr Surprisingness::ji_tv_est(const Handle& pattern,
-                                        const HandleSeq& db)
+                                        const MinerDB& db)
 {
 	// Calculate the truth value estimate of each partition based on
 	// independent assumption of between each partition block, taking
@@ -543,7 +657,7 @@ TruthValuePtr Surprisingness::ji_tv_est(const Handle& pattern,
 }
 
 TruthValuePtr Surprisingness::ji_tv_est_mem(const Handle& pattern,
-                                            const HandleSeq& db)
+                                            const MinerDB& db)
 {
 	TruthValuePtr jte = get_ji_tv_est(pattern);
 	if (jte) {
@@ -761,7 +875,7 @@ HandleSeqUCounter Surprisingness::group_eq(const HandleSeqSeq& partition,
 
 double Surprisingness::eq_prob(const HandleSeqSeq& partition,
                                const Handle& pattern,
-                               const HandleSeq& db)
+                               const MinerDB& db)
 {
 	double p = 1.0;
 	// Calculate the probability of a variable taking the same value
@@ -819,9 +933,10 @@ void Surprisingness::set_emp_tv(const Handle& pattern, TruthValuePtr etv)
 	pattern->setValue(emp_tv_key(), ValueCast(etv));
 }
 
-void Surprisingness::set_emp_prob(const Handle& pattern, double ep)
+void Surprisingness::set_emp_prob(const Handle& pattern, double ep,
+                                  double conf)
 {
-	TruthValuePtr etv = createSimpleTruthValue(ep, 1.0);
+	TruthValuePtr etv = createSimpleTruthValue(ep, conf);
 	set_emp_tv(pattern, etv);
 }
 
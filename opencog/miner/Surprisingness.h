@@ -30,6 +30,9 @@
 #include <opencog/unify/Unify.h>
 #include <opencog/ure/BetaDistribution.h>
 
+#include "MinerDB.h"
+#include "Valuations.h"
+
 namespace opencog
 {
 
@@ -40,6 +43,10 @@ namespace opencog
 typedef std::vector<HandleSeqSeq> HandleSeqSeqSeq;
 typedef Counter<HandleSeq, unsigned> HandleSeqUCounter;
 
+// Pattern associated to its surprisingness
+typedef std::pair<Handle, double> ScoredPattern;
+typedef std::vector<ScoredPattern> ScoredPatternSeq;
+
 class Surprisingness {
 public:
 	// TODO: We could reframe isurp_old and isurp to use the same
@@ -80,7 +87,7 @@ public:
 	 * they are encoded as lists of lists for performance reasons.
 	 */
 	static double isurp_old(const Handle& pattern,
-	                        const HandleSeq& db,
+	                        const MinerDB& db,
 	                        bool normalize=true);
 
 	/**
@@ -336,10 +343,61 @@ public:
 	 *
 	 * As of today the code calculates the exact count (thus is rather
 	 * slow). We have not experimented with approximated counts yet.
+	 *
+	 * The empirical probability of pattern may be estimated by
+	 * subsampling the db (see emp_prob_pbs), unless subsample is
+	 * false, in which case it is exact.
 	 */
 	static double isurp(const Handle& pattern,
-	                    const HandleSeq& db,
-	                    bool normalize=true);
+	                    const MinerDB& db,
+	                    bool normalize=true,
+	                    bool subsample=true);
+
+	/**
+	 * Return an upper bound of isurp(pattern, db, normalize), cheap to
+	 * calculate since it only involves the empirical probabilities of
+	 * the partition blocks, typically memoized, and the memoized
+	 * support of pattern, if any, not the joint variable probabilities
+	 * (see eq_prob), nor the empirical probability of pattern.
+	 *
+	 * Indeed the estimate of each partition is the product of the
+	 * empirical probabilities of its blocks, times the probability
+	 * that its joint variables take the same values, between 1 and
+	 * 1/M per equality, M being the number of distinct atoms of
+	 * db. The empirical probability of pattern is at most the
+	 * smallest product of the empirical probabilities of the blocks
+	 * of a partition, and at least its memoized support, which may be
+	 * a lower bound, divided by its universe count.
+	 *
+	 * The bound holds as long as the empirical probabilities are
+	 * exact, that is not estimated by subsampling. Patterns with a
+	 * single conjunct have no partition, thus 0 is returned.
+	 */
+	static double isurp_upper_bound(const Handle& pattern,
+	                                const MinerDB& db,
+	                                bool normalize=true);
+
+	/**
+	 * Return the k patterns with the highest I-Surprisingness
+	 * amongst the given ones (see isurp), with their
+	 * I-Surprisingness, in decreasing order. Patterns with a single
+	 * conjunct have no partition, thus are given an I-Surprisingness
+	 * of 0.
+	 *
+	 * The I-Surprisingness is calculated with exact empirical
+	 * probabilities (see isurp with subsample set to false), as
+	 * required by the upper bound.
+	 *
+	 * Patterns are evaluated in decreasing order of upper bound (see
+	 * isurp_upper_bound), so that once k patterns are found, patterns
+	 * with an upper bound not above the I-Surprisingness of the k-th
+	 * best one are skipped, without calculating their empirical
+	 * probabilities, nor their probability estimates.
+	 */
+	static ScoredPatternSeq isurp_topk(const HandleSeq& patterns,
+	                                   const MinerDB& db,
+	                                   unsigned k,
+	                                   bool normalize=true);
 
 	/**
 	 * Return the distance between a value and an interval
@@ -460,7 +518,7 @@ public:
 	 */
 	static unsigned value_count(const HandleSeq& block,
 	                            const Handle& var,
-	                            const HandleSeq& db);
+	                            const MinerDB& db);
 
 	/**
 	 * Return the probability distribution over value of var in the
@@ -468,7 +526,16 @@ public:
 	 */
 	static HandleCounter value_distribution(const HandleSeq& block,
 	                                        const Handle& var,
-	                                        const HandleSeq& db);
+	                                        const MinerDB& db);
+
+	/**
+	 * Return the valuations of the strongly connected component of
+	 * block containing var, w.r.t. db. Other components are ignored
+	 * as they do not affect the values of var.
+	 */
+	static SCValuations var_scvaluations(const HandleSeq& block,
+	                                     const Handle& var,
+	                                     const MinerDB& db);
 
 	/**
 	 * Perform the inner product of a collection of distributions.
@@ -493,34 +560,35 @@ public:
 	/**
 	 * Calculate the universe count of the pattern over the given db
 	 */
-	static double universe_count(const Handle& pattern, const HandleSeq& db);
+	static double universe_count(const Handle& pattern, const MinerDB& db);
 
 	/**
 	 * Given a pattern, a corpus and a probability, calculate the
 	 * support of that pattern.
 	 */
 	static double prob_to_support(const Handle& pattern,
-	                              const HandleSeq& db,
+	                              const MinerDB& db,
 	                              double prob);
 
 	/**
 	 * Calculate the empiric probability of a pattern according to a
 	 * database db.
 	 */
-	static double emp_prob(const Handle& pattern, const HandleSeq& db);
+	static double emp_prob(const Handle& pattern, const MinerDB& db);
 
 	/**
-	 * Like emp_prob with memoization.
+	 * Like emp_prob with memoization. Only exact empirical
+	 * probabilities, memoized with a confidence of 1, are reused.
 	 */
 	static double emp_prob_mem(const Handle& pattern,
-	                           const HandleSeq& db);
+	                           const MinerDB& db);
 
 	/**
 	 * Like emp_prob but subsample the db to have subsize (if db
 	 * size is greater than subsize).
 	 */
 	static double emp_prob_subsmp(const Handle& pattern,
-	                              const HandleSeq& db,
+	                              const MinerDB& db,
 	                              unsigned subsize=UINT_MAX);
 
 	/**
@@ -529,7 +597,7 @@ public:
 	 * place, and subsize is the size of each subsample.
 	 */
 	static double emp_prob_bs(const Handle& pattern,
-	                          const HandleSeq& db,
+	                          const MinerDB& db,
 	                          unsigned n_resample,
 	                          unsigned subsize);
 
@@ -543,34 +611,35 @@ public:
 	 * pbs stands for possibly boostrapping.
 	 */
 	static double emp_prob_pbs(const Handle& pattern,
-	                           const HandleSeq& db,
+	                           const MinerDB& db,
 	                           double prob_estimate);
 
 	/**
-	 * Like emp_prob_pbs with memoization.
+	 * Like emp_prob_pbs with memoization. Subsampled estimates are
+	 * memoized with a lower confidence (see emp_prob_mem).
 	 */
 	static double emp_prob_pbs_mem(const Handle& pattern,
-	                               const HandleSeq& db,
+	                               const MinerDB& db,
 	                               double prob_estimate);
 
 	/**
 	 * Calculate the empiric truth value of a pattern according to a
 	 * database db.
 	 */
-	static TruthValuePtr emp_tv(const Handle& pattern, const HandleSeq& db);
+	static TruthValuePtr emp_tv(const Handle& pattern, const MinerDB& db);
 
 	/**
 	 * Like emp_tv with memoization.
 	 */
 	static TruthValuePtr emp_tv_mem(const Handle& pattern,
-	                                const HandleSeq& db);
+	                                const MinerDB& db);
 
 	/**
 	 * Like emp_tv but subsample the db to have subsize (if db
 	 * size is greater than subsize).
 	 */
 	static TruthValuePtr emp_tv_subsmp(const Handle& pattern,
-	                                   const HandleSeq& db,
+	                                   const MinerDB& db,
 	                                   unsigned subsize=UINT_MAX);
 
 	/**
@@ -579,7 +648,7 @@ public:
 	 * place, and subsize is the size of each subsample.
 	 */
 	static TruthValuePtr emp_tv_bs(const Handle& pattern,
-	                               const HandleSeq& db,
+	                               const MinerDB& db,
 	                               unsigned n_resample,
 	                               unsigned subsize);
 
@@ -593,14 +662,14 @@ public:
 	 * pbs stands for possibly bootstrapping.
 	 */
 	static TruthValuePtr emp_tv_pbs(const Handle& pattern,
-	                                const HandleSeq& db,
+	                                const MinerDB& db,
 	                                double prob_estimate);
 
 	/**
 	 * Like emp_tv_pbs with memoization.
 	 */
 	static TruthValuePtr emp_tv_pbs_mem(const Handle& pattern,
-	                                    const HandleSeq& db,
+	                                    const MinerDB& db,
 	                                    double prob_estimate);
 
 	/**
@@ -645,7 +714,7 @@ public:
 	 * alpha = support_estimate / ts^nc
 	 */
 	static unsigned subsmp_size(const Handle& pattern,
-	                            const HandleSeq& db,
+	                            const MinerDB& db,
 	                            double support_estimate);
 
 	/**
@@ -656,7 +725,7 @@ public:
 	 */
 	static double ji_prob_est(const HandleSeqSeq& partition,
 	                          const Handle& pattern,
-	                          const HandleSeq& db);
+	                          const MinerDB& db);
 
 	/**
 	 * Calculate truth value estimate of a pattern given a partition,
@@ -666,20 +735,20 @@ public:
 	 */
 	static TruthValuePtr ji_tv_est(const HandleSeqSeq& partition,
 	                               const Handle& pattern,
-	                               const HandleSeq& db);
+	                               const MinerDB& db);
 
 	/**
 	 * Like above but doesn't take a partition. Instead all partitions
 	 * are considered, and resulting TV is averaged.
 	 */
 	static TruthValuePtr ji_tv_est(const Handle& pattern,
-	                               const HandleSeq& db);
+	                               const MinerDB& db);
 
 	/**
 	 * Like above but the result is memoized.
 	 */
 	static TruthValuePtr ji_tv_est_mem(const Handle& pattern,
-	                                   const HandleSeq& db);
+	                                   const MinerDB& db);
 
 	/**
 	 * Return true iff the given variable has the same position (same
@@ -896,7 +965,7 @@ public:
 	 */
 	static double eq_prob(const HandleSeqSeq& partition,
 	                      const Handle& pattern,
-	                      const HandleSeq& db);
+	                      const MinerDB& db);
 
 	/**
 	 * Alternate implementation of eq_prob. Takes into syntactical
@@ -905,7 +974,7 @@ public:
 	 */
 	static double eq_prob_alt(const HandleSeqSeq& partition,
 	                          const Handle& pattern,
-	                          const HandleSeq& db);
+	                          const MinerDB& db);
 
 	/**
 	 * Key of the empirical truth value
@@ -917,7 +986,8 @@ public:
 	 */
 	static TruthValuePtr get_emp_tv(const Handle& pattern);
 	static void set_emp_tv(const Handle& pattern, TruthValuePtr etv);
-	static void set_emp_prob(const Handle& pattern, double ep);
+	static void set_emp_prob(const Handle& pattern, double ep,
+	                         double conf=1.0);
 
 	/**
 	 * Key of the joint-independent truth value estimate
@@ -21,11 +21,17 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
 #include <boost/range/algorithm/find.hpp>
 
 #include <opencog/util/Logger.h>
 #include <opencog/util/oc_assert.h>
 #include <opencog/atoms/base/Atom.h>
+#include <opencog/atomspace/AtomSpace.h>
 #include <opencog/atoms/core/LambdaLink.h>
 #include <opencog/atoms/core/TypeUtils.h>
 #include <opencog/atoms/pattern/PatternLink.h>
@@ -96,22 +102,41 @@ unsigned ValuationsBase::size() const
 // SCValuations //
 //////////////////
 
-SCValuations::SCValuations(const Variables& vars, const Handle& satset)
-	: ValuationsBase(vars)
+SCValuations::SCValuations(const Variables& vars,
+                           const MinerDB& mdb,
+                           const Handle& satset)
+	: ValuationsBase(vars), db(mdb), columns(vars.varseq.size()),
+	  totally_abstract(false)
 {
 	if (satset)
 	{
 		OC_ASSERT(satset->get_type() == SET_LINK);
+		ValueIdSeq row(vars.varseq.size());
 		for (const Handle& vals : satset->getOutgoingSet())
 		{
-			if (vars.size() == 1)
-				valuations.push_back({vals});
-			else
-				valuations.push_back(vals->getOutgoingSet());
+			for (unsigned i = 0; i < row.size(); i++)
+			{
+				const Handle& val = row.size() == 1 ? vals
+					: vals->getOutgoingAtom(i);
+				row[i] = db.value_id(val);
+				OC_ASSERT(row[i] != MinerDB::npos,
+				          "Value not in db, there's likely a bug");
+			}
+			push_back(row);
 		}
 	}
 }
 
+SCValuations::SCValuations(const Handle& pattern, const MinerDB& mdb,
+                           const OccurrenceSet* occs)
+	: SCValuations(MinerUtils::get_variables(pattern), mdb,
+	               MinerUtils::restricted_satisfying_set(pattern, mdb,
+	                                                     UINT_MAX, occs))
+{
+	totally_abstract = MinerUtils::totally_abstract(pattern);
+	setup_clause_variables(pattern);
+}
+
 HandleUCounter SCValuations::values(const Handle& var) const
 {
 	return values(index(var));
@@ -120,28 +145,116 @@ HandleUCounter SCValuations::values(const Handle& var) const
 HandleUCounter SCValuations::values(unsigned var_idx) const
 {
 	HandleUCounter vals;
-	for (const HandleSeq& valuation : valuations)
-		vals[valuation[var_idx]]++;
+	for (const auto& idc : histogram(var_idx))
+		vals[db.value(idc.first)] = idc.second;
 	return vals;
 }
 
-const Handle& SCValuations::focus_value(const HandleSeq& values) const
+const ValueIdCounter& SCValuations::histogram(unsigned var_idx) const
+{
+	return _histograms.get(var_idx, [&]() {
+			ValueIdCounter id_counts;
+			for (ValueId id : columns[var_idx])
+				id_counts[id]++;
+			return id_counts;
+		});
+}
+
+unsigned SCValuations::distinct_values(unsigned var_idx) const
+{
+	return histogram(var_idx).size();
+}
+
+const Handle& SCValuations::value(unsigned row, unsigned var_idx) const
 {
-	return values[_var_idx];
+	return db.value(columns[var_idx][row]);
 }
 
-bool SCValuations::operator<(const SCValuations& other) const
+const Handle& SCValuations::focus_value(unsigned row) const
 {
-	return variables < other.variables;
+	return value(row, _var_idx);
+}
+
+const ValueIdSeq& SCValuations::column(unsigned var_idx) const
+{
+	return columns[var_idx];
+}
+
+void SCValuations::push_back(const ValueIdSeq& row)
+{
+	for (unsigned i = 0; i < columns.size(); i++)
+		columns[i].push_back(row[i]);
+	_histograms.clear();
+}
+
+void SCValuations::setup_clause_variables(const Handle& pattern)
+{
+	_clause_vars.clear();
+	for (const Handle& clause : MinerUtils::get_clauses(pattern)) {
+		std::vector<unsigned> var_idxs;
+		HandleSeq to_visit{clause};
+		while (not to_visit.empty()) {
+			Handle h = to_visit.back();
+			to_visit.pop_back();
+			if (variables.is_in_varset(h)) {
+				unsigned var_idx = index(h);
+				if (std::find(var_idxs.begin(), var_idxs.end(), var_idx)
+				    == var_idxs.end())
+					var_idxs.push_back(var_idx);
+			} else if (h->is_link()) {
+				const HandleSeq& outs = h->getOutgoingSet();
+				to_visit.insert(to_visit.end(), outs.begin(), outs.end());
+			}
+		}
+		_clause_vars.push_back(var_idxs);
+	}
+}
+
+bool SCValuations::occurrences(OccurrenceSet& occs) const
+{
+	if (_clause_vars.empty())
+		return false;
+	for (const std::vector<unsigned>& var_idxs : _clause_vars)
+		if (var_idxs.empty())
+			return false;
+
+	std::vector<bool> occurs(db.size(), false);
+	for (unsigned row = 0; row < size(); row++) {
+		for (const std::vector<unsigned>& var_idxs : _clause_vars) {
+			// The data trees containing the grounding of that clause
+			// contain all its values, only consider the rarest.
+			const MinerDB::IndexSeq* roots = nullptr;
+			for (unsigned var_idx : var_idxs) {
+				const MinerDB::IndexSeq& var_roots =
+					db.value_roots(columns[var_idx][row]);
+				if (not roots or var_roots.size() < roots->size())
+					roots = &var_roots;
+			}
+			for (unsigned i : *roots)
+				occurs[i] = true;
+		}
+	}
+
+	MinerDB::IndexSeq indices;
+	for (unsigned i = 0; i < occurs.size(); i++)
+		if (occurs[i])
+			indices.push_back(i);
+	occs = OccurrenceSet(indices, db.size());
+	return true;
 }
 
 unsigned SCValuations::size() const
 {
-	return valuations.size();
+	return columns.empty() ? 0 : columns.front().size();
 }
 
 std::string SCValuations::to_string(const std::string& indent) const
 {
+	HandleSeqSeq valuations(size());
+	for (unsigned row = 0; row < size(); row++)
+		for (unsigned var_idx = 0; var_idx < columns.size(); var_idx++)
+			valuations[row].push_back(value(row, var_idx));
+
 	std::stringstream ss;
 	ss << indent << "variables:" << std::endl
 	   << oc_to_string(variables, indent + OC_TO_STRING_INDENT)
@@ -155,7 +268,8 @@ std::string SCValuations::to_string(const std::string& indent) const
 // Valuations //
 ////////////////
 
-Valuations::Valuations(const Handle& pattern, const HandleSeq& db)
+Valuations::Valuations(const Handle& pattern, const MinerDB& db,
+                       const OccurrenceSet* occs)
 	: ValuationsBase(MinerUtils::get_variables(pattern))
 {
 	// Useless clauses (like redundant, constants, and more) are
@@ -164,38 +278,37 @@ Valuations::Valuations(const Handle& pattern, const HandleSeq& db)
 	Handle reduced_pattern = MinerUtils::remove_useless_clauses(pattern);
 	for (const Handle& cp : MinerUtils::get_component_patterns(reduced_pattern))
 	{
-		Handle satset = MinerUtils::restricted_satisfying_set(cp, db);
-		scvs.insert(SCValuations(MinerUtils::get_variables(cp), satset));
+		scvs.push_back(SCValuations(cp, db, occs));
 	}
+	setup_scv_index();
 	setup_size();
 }
 
-Valuations::Valuations(const Variables& vars, const SCValuationsSet& sc)
+Valuations::Valuations(const Variables& vars, const SCValuationsSeq& sc)
 	: ValuationsBase(vars), scvs(sc)
 {
+	setup_scv_index();
 	setup_size();
 }
 
 Valuations::Valuations(const Variables& vars)
 	: ValuationsBase(vars), _size(0) {}
 
-// TODO: maybe speed this up by sorting the SCValuation in order of variables
 const SCValuations& Valuations::get_scvaluations(const Handle& var) const
 {
-	for (const SCValuations& scv : scvs)
-		if (scv.variables.is_in_varset(var))
-			return scv;
-	throw RuntimeException(TRACE_INFO, "There's likely a bug");
+	return get_scvaluations(index(var));
 }
 
 const SCValuations& Valuations::get_scvaluations(unsigned var_idx) const
 {
-	return get_scvaluations(variable(var_idx));
+	if (var_idx < _scv_idx.size() and _scv_idx[var_idx] < scvs.size())
+		return scvs[_scv_idx[var_idx]];
+	throw RuntimeException(TRACE_INFO, "There's likely a bug");
 }
 
 const SCValuations& Valuations::focus_scvaluations() const
 {
-	return get_scvaluations(focus_variable());
+	return get_scvaluations(_var_idx);
 }
 
 void Valuations::inc_focus_variable() const
@@ -210,25 +323,38 @@ void Valuations::dec_focus_variable() const
 	focus_scvaluations().dec_focus_variable();
 }
 
-HandleUCounter Valuations::values(const Handle& var) const
+const HandleUCounter& Valuations::values(const Handle& var) const
 {
 	return values(index(var));
 }
 
-HandleUCounter Valuations::values(unsigned var_idx) const
+const HandleUCounter& Valuations::values(unsigned var_idx) const
 {
-	// Get values from corresponding component
-	const SCValuations& var_scv = get_scvaluations(var_idx);
-	HandleUCounter var_values = var_scv.values(variable(var_idx));
+	return _histograms.get(var_idx, [&]() {
+			// Get values from corresponding component
+			const SCValuations& var_scv = get_scvaluations(var_idx);
+			HandleUCounter var_values = var_scv.values(variable(var_idx));
 
-	// Take into account disconnected components
-	unsigned factor = 1;
-	for (const SCValuations& other_scv : scvs)
-		if (&var_scv != &other_scv)
-			factor *= other_scv.size();
-	var_values *= factor;
+			// Take into account disconnected components
+			unsigned factor = 1;
+			for (const SCValuations& other_scv : scvs)
+				if (&var_scv != &other_scv)
+					factor *= other_scv.size();
+			var_values *= factor;
 
-	return var_values;
+			return var_values;
+		});
+}
+
+unsigned Valuations::distinct_values(const Handle& var) const
+{
+	return distinct_values(index(var));
+}
+
+unsigned Valuations::distinct_values(unsigned var_idx) const
+{
+	const SCValuations& var_scv = get_scvaluations(var_idx);
+	return var_scv.distinct_values(var_scv.index(variable(var_idx)));
 }
 
 unsigned Valuations::size() const
@@ -236,6 +362,220 @@ unsigned Valuations::size() const
 	return _size;
 }
 
+bool Valuations::specialize(const Handle& var,
+                            const Handle& shapat,
+                            const Handle& npat,
+                            Valuations& nvals) const
+{
+	nvals = Valuations(MinerUtils::get_variables(npat));
+	if (not specialize_scvs(var, shapat, npat, nvals.scvs))
+		return false;
+	nvals.setup_scv_index();
+	nvals.setup_size();
+	return true;
+}
+
+bool Valuations::specialize_scvs(const Handle& var,
+                                 const Handle& shapat,
+                                 const Handle& npat,
+                                 SCValuationsSeq& nscvs) const
+{
+	const SCValuations& var_scv = get_scvaluations(var);
+	unsigned var_idx = var_scv.index(var);
+
+	// If shapat is a remaining variable, get its strongly connected
+	// valuations and its index in them.
+	const SCValuations* rv_scv = nullptr;
+	unsigned rv_idx = 0;
+	if (shapat->get_type() == VARIABLE_NODE and shapat != var and
+	    variables.is_in_varset(shapat)) {
+		rv_scv = &get_scvaluations(shapat);
+		rv_idx = rv_scv->index(shapat);
+	}
+
+	// If shapat is a single operator pattern, get its body. Unordered
+	// links are not supported because the pattern matcher would
+	// produce all their permutations, and quoted links are not
+	// supported for simplicity.
+	Handle shabody;
+	if (shapat->get_type() == LAMBDA_LINK) {
+		shabody = MinerUtils::get_body(shapat);
+		Type bt = shabody->get_type();
+		if (bt == LOCAL_QUOTE_LINK or nameserver().isA(bt, UNORDERED_LINK))
+			return false;
+	}
+
+	// Values of totally abstract components are the data trees of db
+	// rather than all their subtrees, thus cannot be used to derive
+	// the values of more specialized components.
+	if (var_scv.totally_abstract or (rv_scv and rv_scv->totally_abstract))
+		return false;
+
+	// If var and shapat are in different strongly connected
+	// valuations, then collect their values to filter rows that
+	// cannot be joined.
+	const MinerDB& db = var_scv.db;
+	bool same_scv = rv_scv == &var_scv;
+	std::unordered_set<ValueId> var_vals, rv_vals;
+	if (rv_scv and not same_scv) {
+		const ValueIdSeq& var_col = var_scv.column(var_idx);
+		const ValueIdSeq& rv_col = rv_scv->column(rv_idx);
+		var_vals.insert(var_col.begin(), var_col.end());
+		rv_vals.insert(rv_col.begin(), rv_col.end());
+	}
+
+	// If shapat is a constant, get its identifier in db
+	ValueId shapat_id = MinerDB::npos;
+	if (not shabody and not rv_scv)
+		shapat_id = db.value_id(shapat);
+
+	// Return true iff a row of scv is compatible with shapat. Values
+	// are inspected through the flat encoding of db.
+	auto keep = [&](const SCValuations* scv, unsigned row) {
+		if (scv == &var_scv) {
+			ValueId id = var_scv.columns[var_idx][row];
+			if (shabody)
+				return db.value_type(id) == shabody->get_type() and
+					db.value_arity(id) == shabody->get_arity();
+			if (rv_scv)
+				return same_scv ? id == var_scv.columns[rv_idx][row]
+					: rv_vals.find(id) != rv_vals.end();
+			return id == shapat_id;
+		}
+		if (scv == rv_scv)
+			return var_vals.find(rv_scv->columns[rv_idx][row]) != var_vals.end();
+		return true;
+	};
+
+	// Where to fetch the value of a variable of npat, that is from
+	// which column of which strongly connected valuations, and if
+	// shapat is a single operator pattern, which outgoing of it.
+	struct Source {
+		const SCValuations* scv;
+		unsigned idx;
+		int out;
+	};
+
+	Handle reduced_npat = MinerUtils::remove_useless_clauses(npat);
+	for (const Handle& cp : MinerUtils::get_component_patterns(reduced_npat))
+	{
+		const Variables& cvars = MinerUtils::get_variables(cp);
+
+		// Find the source of each variable
+		std::vector<Source> srcs;
+		std::set<const SCValuations*> src_scvs;
+		for (const Handle& cv : cvars.varseq) {
+			if (cv != var and variables.is_in_varset(cv)) {
+				const SCValuations& cv_scv = get_scvaluations(cv);
+				srcs.push_back({&cv_scv, cv_scv.index(cv), -1});
+			} else if (shabody) {
+				const HandleSeq& outs = shabody->getOutgoingSet();
+				auto it = std::find(outs.begin(), outs.end(), cv);
+				if (it == outs.end())
+					return false;
+				srcs.push_back({&var_scv, var_idx,
+				                (int)std::distance(outs.begin(), it)});
+			} else {
+				return false;
+			}
+			src_scvs.insert(srcs.back().scv);
+		}
+
+		// Filtered components cannot be totally abstract, so if one
+		// is, let the pattern matcher handle it.
+		bool filtered = src_scvs.count(&var_scv) or src_scvs.count(rv_scv);
+		if (filtered and MinerUtils::totally_abstract(cp))
+			return false;
+
+		// Outgoings of values are subtrees of the db, thus have been
+		// interned as well.
+		auto value_id = [&](const Source& src, unsigned row) {
+			ValueId id = src.scv->columns[src.idx][row];
+			return src.out < 0 ? id : db.value_child(id, src.out);
+		};
+
+		// Build the rows of the new strongly connected valuations,
+		// discarding duplicates.
+		std::set<ValueIdSeq> rows;
+		ValueIdSeq nrow(srcs.size());
+		if (src_scvs.size() == 1) {
+			const SCValuations* scv = *src_scvs.begin();
+			for (unsigned row = 0; row < scv->size(); row++) {
+				if (not keep(scv, row))
+					continue;
+				for (unsigned i = 0; i < srcs.size(); i++)
+					nrow[i] = value_id(srcs[i], row);
+				rows.insert(nrow);
+			}
+		} else if (src_scvs.size() == 2 and rv_scv and
+		           src_scvs.count(&var_scv) and src_scvs.count(rv_scv)) {
+			// Join the rows of var_scv and rv_scv over the values of
+			// var and shapat.
+			std::unordered_map<ValueId, std::vector<unsigned>> rv_rows;
+			const ValueIdSeq& rv_col = rv_scv->column(rv_idx);
+			for (unsigned rv_row = 0; rv_row < rv_col.size(); rv_row++)
+				rv_rows[rv_col[rv_row]].push_back(rv_row);
+			const ValueIdSeq& var_col = var_scv.column(var_idx);
+			for (unsigned var_row = 0; var_row < var_col.size(); var_row++) {
+				auto it = rv_rows.find(var_col[var_row]);
+				if (it == rv_rows.end())
+					continue;
+				for (unsigned rv_row : it->second) {
+					for (unsigned i = 0; i < srcs.size(); i++)
+						nrow[i] = value_id(srcs[i], srcs[i].scv == &var_scv ?
+						                   var_row : rv_row);
+					rows.insert(nrow);
+				}
+			}
+		} else {
+			return false;
+		}
+
+		SCValuations nscv(cvars, db);
+		for (const ValueIdSeq& row : rows)
+			nscv.push_back(row);
+		nscv.totally_abstract = MinerUtils::totally_abstract(cp);
+		nscv.setup_clause_variables(cp);
+		nscvs.push_back(nscv);
+	}
+
+	return true;
+}
+
+bool Valuations::occurrences(OccurrenceSet& occs) const
+{
+	if (scvs.empty())
+		return false;
+
+	for (const SCValuations& scv : scvs)
+		if (scv.totally_abstract)
+			return false;
+
+	occs = OccurrenceSet(scvs.front().db.size());
+	for (const SCValuations& scv : scvs) {
+		OccurrenceSet scv_occs;
+		if (not scv.occurrences(scv_occs))
+			return false;
+		occs = occs.unite(scv_occs);
+	}
+	return true;
+}
+
+void Valuations::rename(const Variables& nvariables,
+                        const HandleMap& var2var)
+{
+	for (SCValuations& scv : scvs) {
+		HandleSeq nvars;
+		for (const Handle& var : scv.variables.varseq)
+			nvars.push_back(var2var.at(var));
+		scv.variables = Variables(MinerUtils::variable_list(nvars));
+	}
+	variables = nvariables;
+	_var_idx = 0;
+	setup_scv_index();
+	setup_size();
+}
+
 std::string Valuations::to_string(const std::string& indent) const
 {
 	std::stringstream ss;
@@ -250,17 +590,26 @@ std::string Valuations::to_string(const std::string& indent) const
 
 void Valuations::setup_size()
 {
+	_histograms.clear();
 	_size = scvs.empty() ? 0 : 1;
 	for (const SCValuations& scv : scvs)
 		_size *= scv.size();
 }
 
+void Valuations::setup_scv_index()
+{
+	_scv_idx.assign(variables.varseq.size(), (unsigned)-1);
+	for (unsigned i = 0; i < scvs.size(); i++)
+		for (const Handle& var : scvs[i].variables.varseq)
+			_scv_idx[index(var)] = i;
+}
+
 std::string oc_to_string(const SCValuations& scv, const std::string& indent)
 {
 	return scv.to_string(indent);
 }
 
-std::string oc_to_string(const SCValuationsSet& scvs, const std::string& indent)
+std::string oc_to_string(const SCValuationsSeq& scvs, const std::string& indent)
 {
 	std::stringstream ss;
 	ss << indent << "size = " << scvs.size() << std::endl;
@@ -23,13 +23,69 @@
 #ifndef OPENCOG_VALUATIONS_H_
 #define OPENCOG_VALUATIONS_H_
 
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 #include <opencog/util/empty_string.h>
 #include <opencog/atoms/base/Handle.h>
 #include <opencog/atoms/core/Variables.h>
 
+#include "MinerDB.h"
+#include "OccurrenceSet.h"
+
 namespace opencog
 {
 
+// Map value identifiers (see MinerDB::value_id) to their counts
+typedef std::unordered_map<ValueId, unsigned> ValueIdCounter;
+
+/**
+ * Cache of value histograms, one per variable index, lazily filled
+ * and thread safe. Copies start empty, since the valuations they
+ * belong to are typically modified after being copied.
+ */
+template<typename Counter>
+class HistogramCache
+{
+public:
+	HistogramCache() {}
+	HistogramCache(const HistogramCache&) {}
+	HistogramCache& operator=(const HistogramCache&)
+	{
+		clear();
+		return *this;
+	}
+
+	/**
+	 * Return the histogram of the variable at var_idx, calling fill
+	 * to calculate it if not cached yet.
+	 */
+	template<typename Fill>
+	const Counter& get(unsigned var_idx, const Fill& fill) const
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		auto it = _counters.find(var_idx);
+		if (it == _counters.end())
+			it = _counters.insert({var_idx, fill()}).first;
+		return it->second;
+	}
+
+	/**
+	 * Invalidate all histograms, to be called when rows change.
+	 */
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_counters.clear();
+	}
+
+private:
+	mutable std::mutex _mtx;
+	mutable std::map<unsigned, Counter> _counters;
+};
+
 class ValuationsBase
 {
 public:
@@ -89,19 +145,33 @@ protected:
 
 /**
  * Valuations for a single strongly connected component.
+ *
+ * Values are stored in columns, one per variable, of identifiers of
+ * the values interned in the db (see MinerDB::value_id), so that the
+ * i-th row, or valuation, is made of the i-th element of each column.
  */
 class SCValuations : public ValuationsBase
 {
 public:
 	/**
 	 * Given variables and a satisfying set obtained by running a
-	 * satisfying_set pattern matcher query, resulting in
+	 * satisfying_set pattern matcher query over db, resulting in
 	 *
 	 * (Set (List v11 ... v1m) ... (List vn1 ... vnm))
 	 *
 	 * construct the corresponding Valuations.
 	 */
-	SCValuations(const Variables& variables, const Handle& satset=Handle::UNDEFINED);
+	SCValuations(const Variables& variables,
+	             const MinerDB& db,
+	             const Handle& satset=Handle::UNDEFINED);
+
+	/**
+	 * Given a strongly connected pattern and db, calculate its
+	 * valuations. If provided, only the data trees of occs are
+	 * matched (see MinerUtils::restricted_satisfying_set).
+	 */
+	SCValuations(const Handle& pattern, const MinerDB& db,
+	             const OccurrenceSet* occs=nullptr);
 
 	/**
 	 * Return all counted values corresponding to var.
@@ -110,17 +180,59 @@ public:
 	HandleUCounter values(unsigned var_idx) const;
 
 	/**
-	 * Return the value under focus (at var_idx) of a give row of
-	 * values.
+	 * Return the counts of the value identifiers of the variable at
+	 * var_idx. Cached till rows change.
+	 */
+	const ValueIdCounter& histogram(unsigned var_idx) const;
+
+	/**
+	 * Return the number of distinct values of the variable at
+	 * var_idx.
+	 */
+	unsigned distinct_values(unsigned var_idx) const;
+
+	/**
+	 * Return the value at the given row for the variable at var_idx.
+	 */
+	const Handle& value(unsigned row, unsigned var_idx) const;
+
+	/**
+	 * Return the value under focus (at var_idx) of the given row.
+	 */
+	const Handle& focus_value(unsigned row) const;
+
+	/**
+	 * Return the column of value identifiers of the variable at
+	 * var_idx.
+	 */
+	const ValueIdSeq& column(unsigned var_idx) const;
+
+	/**
+	 * Append a row of value identifiers, one per variable.
 	 */
-	const Handle& focus_value(const HandleSeq& values) const;
+	void push_back(const ValueIdSeq& row);
 
 	/**
-	 * Less than relationship according to Variables, because it's
-	 * cheap and no 2 SCValuations with same variables will be in the
-	 * same set at once.
+	 * Record the indices of the variables of each clause of pattern,
+	 * the strongly connected pattern these valuations are the values
+	 * of, as required by occurrences.
 	 */
-	bool operator<(const SCValuations& other) const;
+	void setup_clause_variables(const Handle& pattern);
+
+	/**
+	 * Fill occs with the data trees of db that may contain the
+	 * groundings of the clauses of the pattern of these valuations.
+	 * That is, for each row and clause, the data trees containing the
+	 * value of a variable of that clause, picking the one with the
+	 * fewest occurrences (see MinerDB::value_roots).
+	 *
+	 * Since the groundings of a specialization are groundings of its
+	 * parent, it can be matched against these data trees only.
+	 *
+	 * Return false if unknown, that is if the clause variables have
+	 * not been set up or some clause has no variable.
+	 */
+	bool occurrences(OccurrenceSet& occs) const;
 
 	/**
 	 * Return the size of the SCValuations, that is its number of
@@ -130,12 +242,28 @@ public:
 
 	std::string to_string(const std::string& indent=empty_string) const;
 
-	// Actual valuations, sequence of tuples of values associated to
-	// each variable.
-	HandleSeqSeq valuations;
+	// Db where values are interned
+	MinerDB db;
+
+	// Actual valuations, one column of value identifiers per
+	// variable.
+	std::vector<ValueIdSeq> columns;
+
+	// True iff the component these valuations are obtained from is
+	// totally abstract (see MinerUtils::totally_abstract), in which
+	// case its values are the db data trees rather than the results
+	// of the pattern matcher.
+	bool totally_abstract;
+
+private:
+	HistogramCache<ValueIdCounter> _histograms;
+
+	// Indices of the variables of each clause of the pattern, see
+	// setup_clause_variables.
+	std::vector<std::vector<unsigned>> _clause_vars;
 };
 
-typedef std::set<SCValuations> SCValuationsSet;
+typedef std::vector<SCValuations> SCValuationsSeq;
 
 /**
  * Class representing valuations of a pattern against a data tree,
@@ -148,14 +276,18 @@ class Valuations : public ValuationsBase
 public:
 	/**
 	 * Given a pattern and db (ground terms), calculate its
-	 * valuations.
+	 * valuations. If provided, only the data trees of occs are
+	 * matched, occs being for instance the occurrences of a
+	 * generalization of pattern (see occurrences).
 	 */
-	Valuations(const Handle& pattern, const HandleSeq& db);
-	Valuations(const Variables& variables, const SCValuationsSet& scvs);
+	Valuations(const Handle& pattern, const MinerDB& db,
+	           const OccurrenceSet* occs=nullptr);
+	Valuations(const Variables& variables, const SCValuationsSeq& scvs);
 	Valuations(const Variables& variables);
 
 	/**
-	 * Get the SCValuations containing the given variable.
+	 * Get the SCValuations containing the given variable. Constant
+	 * time given its index.
 	 */
 	const SCValuations& get_scvaluations(const Handle& var) const;
 	const SCValuations& get_scvaluations(unsigned var_idx) const;
@@ -174,10 +306,18 @@ public:
 	void dec_focus_variable() const;
 
 	/**
-	 * Return all counted values corresponding to var.
+	 * Return all counted values corresponding to var, accounting for
+	 * the combinations with the other strongly connected
+	 * valuations. Cached till rows change.
 	 */
-	HandleUCounter values(const Handle& var) const;
-	HandleUCounter values(unsigned var_idx) const;
+	const HandleUCounter& values(const Handle& var) const;
+	const HandleUCounter& values(unsigned var_idx) const;
+
+	/**
+	 * Return the number of distinct values of var.
+	 */
+	unsigned distinct_values(const Handle& var) const;
+	unsigned distinct_values(unsigned var_idx) const;
 
 	/**
 	 * Return the size of the Valuations, that is its totally number
@@ -186,24 +326,91 @@ public:
 	 */
 	unsigned size() const;
 
+	/**
+	 * Fill occs with the union of the occurrences of all strongly
+	 * connected valuations (see SCValuations::occurrences). Return
+	 * false if unknown for some of them, or if some are totally
+	 * abstract, as their occurrences are then the whole db.
+	 */
+	bool occurrences(OccurrenceSet& occs) const;
+
+	/**
+	 * Given npat, the specialization of the pattern of these
+	 * valuations obtained by composing var with shapat (see
+	 * MinerUtils::focus_shallow_abstract), return the valuations of
+	 * npat. These are derived by filtering and projecting the rows of
+	 * the valuations of the pattern, rather than running the pattern
+	 * matcher, for the 3 sorts of shallow abstractions, that is
+	 *
+	 * 1. Constant nodes, only rows where var is that constant are
+	 *    kept.
+	 *
+	 * 2. Single operator patterns, like (Lambda X Y (Inheritance X Y)),
+	 *    only rows where var is an Inheritance are kept, and var is
+	 *    replaced by its outgoings.
+	 *
+	 * 3. Remaining variables, only rows where var and that variable
+	 *    are equal are kept, possibly joining 2 strongly connected
+	 *    valuations.
+	 *
+	 * The derived valuations are stored in nvals. Return false if
+	 * they cannot be derived, which happens with totally abstract
+	 * components, unordered links or quoted links, in which case they
+	 * must be calculated from scratch over the db.
+	 */
+	bool specialize(const Handle& var,
+	                const Handle& shapat,
+	                const Handle& npat,
+	                Valuations& nvals) const;
+
+	/**
+	 * Set nvariables as variables, and rename the variables of each
+	 * strongly connected valuations according to var2var, in place,
+	 * so that their values are not copied. Used to follow the
+	 * renaming of the variables of a pattern (see
+	 * MinerUtils::canonical_pattern).
+	 */
+	void rename(const Variables& nvariables, const HandleMap& var2var);
+
 	std::string to_string(const std::string& indent) const;
 
-	SCValuationsSet scvs;
+	SCValuationsSeq scvs;
 
 private:
 	/**
-	 * Calculate and set _size
+	 * Derive the strongly connected valuations of npat, as described
+	 * in specialize, and append them to nscvs. Return false if they
+	 * cannot be derived.
+	 */
+	bool specialize_scvs(const Handle& var,
+	                     const Handle& shapat,
+	                     const Handle& npat,
+	                     SCValuationsSeq& nscvs) const;
+
+	/**
+	 * Calculate and set _size, and invalidate cached histograms.
 	 */
 	void setup_size();
 
+	/**
+	 * Fill _scv_idx, to be called whenever scvs changes.
+	 */
+	void setup_scv_index();
+
 	unsigned _size;
+
+	// Map the index of each variable to the index of its strongly
+	// connected valuations in scvs.
+	std::vector<unsigned> _scv_idx;
+
+	HistogramCache<HandleUCounter> _histograms;
 };
 
 typedef std::map<Handle, Valuations> HandleValuationsMap;
 
 std::string oc_to_string(const SCValuations& scvaluations,
                          const std::string& indent=empty_string);
-std::string oc_to_string(const SCValuationsSet& scvs,
+std::string oc_to_string(const SCValuationsSeq& scvs,
                          const std::string& indent=empty_string);
 std::string oc_to_string(const Valuations& valuations,
                          const std::string& indent=empty_string);
@@ -0,0 +1,109 @@
+/*
+ * miner-snapshot.cc
+ *
+ * Copyright (C) 2026 OpenCog Foundation
+ *
+ * Author: agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License v3 as
+ * published by the Free Software Foundation and including the exceptions
+ * at http://opencog.org/wiki/Licenses
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program; if not, write to:
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Convert scheme corpora into a binary snapshot of a miner db, once,
+ * so that it can later be bulk loaded with
+ *
+ * MinerDB::open(snapshot).load(as)
+ *
+ * without the scheme interpreter. Usage
+ *
+ * miner-snapshot CORPUS.scm [CORPUS.scm ...] SNAPSHOT
+ *
+ * The time taken by each step, including reloading the snapshot, is
+ * measured and reported, so that it can be compared to the time taken
+ * to evaluate the corpora.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <opencog/util/exceptions.h>
+#include <opencog/atomspace/AtomSpace.h>
+#include <opencog/guile/SchemeEval.h>
+
+#include "MinerDB.h"
+
+using namespace opencog;
+
+typedef std::chrono::steady_clock Clock;
+
+// Return the time in seconds elapsed since start
+static double seconds_since(const Clock::time_point& start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		std::cerr << "Usage: " << argv[0]
+		          << " CORPUS.scm [CORPUS.scm ...] SNAPSHOT" << std::endl;
+		return 1;
+	}
+	std::string snapshot(argv[argc - 1]);
+
+	try {
+		// Evaluate the corpora
+		AtomSpace as;
+		SchemeEval scm(&as);
+		Clock::time_point start = Clock::now();
+		for (int i = 1; i + 1 < argc; i++) {
+			scm.eval("(load \"" + std::string(argv[i]) + "\")");
+			if (scm.eval_error()) {
+				std::cerr << "Cannot load " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		double eval_time = seconds_since(start);
+
+		// Save the snapshot
+		start = Clock::now();
+		MinerDB db(as);
+		db.save(snapshot);
+		double save_time = seconds_since(start);
+
+		// Reload it, as a miner db, then into an atomspace
+		start = Clock::now();
+		MinerDB sdb = MinerDB::open(snapshot);
+		double open_time = seconds_since(start);
+		start = Clock::now();
+		AtomSpace sas;
+		sdb.load(sas);
+		double load_time = seconds_since(start);
+
+		std::cout << "Data trees: " << db.size() << std::endl
+		          << "Distinct atoms: " << sas.get_size() << std::endl
+		          << "Evaluate corpora: " << eval_time << "s" << std::endl
+		          << "Save snapshot: " << save_time << "s" << std::endl
+		          << "Open snapshot: " << open_time << "s" << std::endl
+		          << "Load snapshot: " << load_time << "s" << std::endl;
+	}
+	catch (const StandardException& e) {
+		std::cerr << e.get_message() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -455,6 +455,32 @@
          (gl (Get vardecl (And (Present target) precond))))
     (cog-execute! gl)))
 
+(define (select-patterns mode patterns db ms mc mv es)
+"
+  Given a list of patterns with enough support, return the closed
+  ones, with no specialization of equal support, if mode is 'closed,
+  the maximal ones, with no specialization of enough support, if mode
+  is 'maximal, or all of them otherwise. See cog-mine for the other
+  arguments.
+
+  The minsup evaluations of the discarded patterns are reset to the
+  default truth value so that they are ignored by the surprisingness
+  rules.
+"
+  (let* ((select (cond ((equal? mode 'closed) cog-closed-patterns)
+                       ((equal? mode 'maximal) cog-maximal-patterns)
+                       (else #f))))
+    (if (not select)
+        patterns
+        (let* ((mc-n (Number (if (or (<= mc 0) (< 9 mc)) 9 mc)))
+               (mv-n (Number (min 9 mv)))
+               (selected (cog-outgoing-set
+                           (select (Set patterns) db ms mc-n mv-n es)))
+               (discard (lambda (pattern)
+                          (cog-set-tv! (minsup-eval pattern db ms) (stv 1 0)))))
+          (for-each discard (lset-difference equal? patterns selected))
+          selected))))
+
 (define* (conjunct-pattern nconj)
 "
   Create a pattern of nconj conjunctions.
@@ -505,7 +531,8 @@
                    (max-conjuncts 3)
                    (max-variables 3)
                    (max-cnjexp-variables 2)
-                   (surprisingness 'isurp))
+                   (surprisingness 'isurp)
+                   (output 'all))
 "
   Mine patterns in db (data trees, a.k.a. grounded hypergraphs) with minimum
   support ms, optionally using mi iterations and starting from the initial
@@ -522,7 +549,8 @@
                    #:max-conjuncts mc
                    #:max-variables mv
                    #:max-cnjexp-variables mcev
-                   #:surprisingness su)
+                   #:surprisingness su
+                   #:output om)
 
   db: Collection of data trees to mine. It can be given in 3 forms
 
@@ -616,6 +644,21 @@
 
       'none:       No surprisingness measure is applied.
 
+  om: [optional, default='all] Patterns to output, before ranking them
+      by surprisingness. The following supported modes are:
+
+      'all:     All patterns with enough support.
+
+      'closed:  Only closed patterns, that is with no specialization
+                of equal support, as the others are redundant.
+
+      'maximal: Only maximal patterns, that is with no specialization
+                of enough support.
+
+      Specializations are shallow specializations and, if conjunction
+      expansion is enabled, expansions with the mined single conjunct
+      patterns.
+
   Under the hood it will create a rule base and a query for the rule
   engine, configure it according to the user's options and run it.
   Everything takes place in a child atomspace. After the job is done
@@ -686,7 +729,16 @@
                (results (cog-fc miner-rbs source))
                ;; Fetch all relevant results
                (patterns (fetch-patterns db-cpt ms-n))
-               (patterns-lst (cog-outgoing-set patterns)))
+               ;; Only keep closed or maximal patterns if requested
+               (patterns-lst (select-patterns output
+                                              (cog-outgoing-set patterns)
+                                              db-cpt
+                                              ms-n
+                                              (if conjunction-expansion
+                                                  max-conjuncts
+                                                  1)
+                                              max-variables
+                                              enforce-specialization)))
 
           (if (equal? surprisingness 'none)
 
@@ -737,6 +789,7 @@
     get-members
     get-cardinality
     fetch-patterns
+    select-patterns
     conjunct-pattern
     cog-miner
     cog-mine
@@ -184,7 +184,7 @@ Handle MinerUTestUtils::ure_pm(AtomSpace& as,
 
 	// Add the axiom that initpat has enough support, and use it as
 	// source for the forward chainer
-	bool es = MinerUtils::enough_support(initpat, db, minsup);
+	bool es = MinerUtils::enough_support(initpat, MinerDB(db), minsup);
 
 	// If it doesn't have enough support return the empty solution
 	if (not es)
@@ -223,9 +223,10 @@ HandleTree MinerUTestUtils::cpp_pm(const AtomSpace& db_as,
                                    int minsup,
                                    int conjuncts,
                                    const Handle& initpat,
-                                   int maxdepth)
+                                   int maxdepth,
+                                   unsigned jobs)
 {
-	MinerParameters param(minsup, conjuncts, initpat, maxdepth);
+	MinerParameters param(minsup, conjuncts, initpat, maxdepth, jobs);
 	Miner pm(param);
 	return pm(db_as);
 }
@@ -234,11 +235,12 @@ HandleTree MinerUTestUtils::cpp_pm(const HandleSeq& db,
                                    int minsup,
                                    int conjuncts,
                                    const Handle& initpat,
-                                   int maxdepth)
+                                   int maxdepth,
+                                   unsigned jobs)
 {
-	MinerParameters param(minsup, conjuncts, initpat, maxdepth);
+	MinerParameters param(minsup, conjuncts, initpat, maxdepth, jobs);
 	Miner pm(param);
-	return pm(db);
+	return pm(MinerDB(db));
 }
 
 Handle MinerUTestUtils::add_is_cpt_pattern(AtomSpace& as, const Handle& cpt)
@@ -204,12 +204,14 @@ public:
 	                         int minsup=1,
 	                         int conjuncts=1,
 	                         const Handle& initpat=Handle::UNDEFINED,
-	                         int maxdepth=-1);
+	                         int maxdepth=-1,
+	                         unsigned jobs=1);
 	static HandleTree cpp_pm(const HandleSeq& db,
 	                         int minsup=1,
 	                         int conjuncts=1,
 	                         const Handle& initpat=Handle::UNDEFINED,
-	                         int maxdepth=-1);
+	                         int maxdepth=-1,
+	                         unsigned jobs=1);
 
 	/**
 	 * Add